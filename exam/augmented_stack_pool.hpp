@@ -0,0 +1,157 @@
+#pragma once
+
+#include "stack_pool.hpp"
+#include <limits>
+#include <utility>
+
+// monoids which can be used with augmented_stack_pool. A monoid is a
+// callable object implementing an associative operation, whose static
+// member identity() returns the neutral element.
+namespace monoids {
+  template <typename T>
+  struct sum {
+    static T identity() { return T{}; }
+    T operator()(const T& a, const T& b) const { return a + b; }
+  };
+
+  template <typename T>
+  struct min {
+    static T identity() { return std::numeric_limits<T>::max(); }
+    T operator()(const T& a, const T& b) const { return b < a ? b : a; }
+  };
+
+  template <typename T>
+  struct max {
+    static T identity() { return std::numeric_limits<T>::lowest(); }
+    T operator()(const T& a, const T& b) const { return a < b ? b : a; }
+  };
+}  // namespace monoids
+
+/**
+ * @brief A pool of stacks which knows the aggregate (e.g. minimum, maximum,
+ * sum) of each stack in O(1).
+ *
+ * Each node stores, besides its value, the aggregate of its value and all
+ * the values below it: `aggregate(x) == op(value(x), aggregate(next(x)))`.
+ * Since nodes below the head never change, push computes the aggregate of
+ * the new node in O(1) from the aggregate of the former head, and the
+ * aggregate of any node (i.e. of any stack, or portion of a stack) is just
+ * read.
+ *
+ * For the same reason values cannot be modified once pushed, therefore only
+ * const accessors are provided. Everything else works as in stack_pool,
+ * which is used to store the nodes.
+ *
+ * @tparam T Type of the values to be held in the stacks of this pool.
+ * @tparam Monoid The operation used to aggregate values (see monoids).
+ * @tparam N Type using to designate the head of a stack.
+ */
+template <typename T, typename Monoid = monoids::sum<T>, typename N = std::size_t>
+class augmented_stack_pool {
+  struct augmented_value {
+    T value;
+    T aggregate;
+  };
+
+  stack_pool<augmented_value, N> pool;
+  Monoid op;
+
+  using stack_type = N;
+  using size_type = std::size_t;
+
+  template <typename X>
+  stack_type _push(X&& val, stack_type head) {
+    T agg = op(val, aggregate(head));
+    return pool.push(augmented_value{std::forward<X>(val), std::move(agg)},
+                     head);
+  }
+
+ public:
+  augmented_stack_pool() = default;
+
+  /**
+   * @brief Construct a new pool having a given initial capacity.
+   *
+   * @param n The initial capacity of the pool.
+   * @param m The monoid used to aggregate values.
+   */
+  explicit augmented_stack_pool(size_type n, Monoid m = Monoid{})
+      : pool{n}, op{std::move(m)} {}
+
+  stack_type new_stack() noexcept { return pool.new_stack(); }
+  void reserve(size_type n) { pool.reserve(n); }
+  size_type capacity() const noexcept { return pool.capacity(); }
+  bool empty(stack_type x) const noexcept { return pool.empty(x); }
+  stack_type end() const noexcept { return pool.end(); }
+
+  /**
+   * @brief Return the front value in the given stack.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param x
+   * @return const T&
+   */
+  const T& value(stack_type x) const { return pool.value(x).value; }
+
+  /**
+   * @brief Return the next node in the given stack.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param x
+   * @return stack_type
+   */
+  stack_type next(stack_type x) const { return pool.next(x); }
+
+  /**
+   * @brief Return the aggregate of all the values in the stack starting at
+   * `x`, in O(1). The aggregate of an empty stack is `Monoid::identity()`.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param x
+   * @return T
+   */
+  T aggregate(stack_type x) const {
+    return empty(x) ? Monoid::identity() : pool.value(x).aggregate;
+  }
+
+  /**
+   * @brief Push an element to the front of the stack. Returns the new head of
+   * the stack.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool (its aggregate is needed).
+   *
+   * @param val Value to be pushed.
+   * @param head Head of the stack.
+   * @return stack_type
+   */
+  stack_type push(const T& val, stack_type head) { return _push(val, head); }
+  stack_type push(T&& val, stack_type head) {
+    return _push(std::move(val), head);
+  }
+
+  /**
+   * @brief Pop the head of the given stack. See stack_pool::pop.
+   */
+  stack_type pop(stack_type head) { return pool.pop(head); }
+
+  /**
+   * @brief Empty the given stack. See stack_pool::free_stack.
+   */
+  stack_type free_stack(stack_type head) { return pool.free_stack(head); }
+
+  /**
+   * @brief Call `f` on each value of the given stack, from top to bottom.
+   * See stack_pool::for_each.
+   */
+  template <typename F>
+  void for_each(stack_type x, F f) const {
+    pool.for_each(x, [&f](const augmented_value& v) { f(v.value); });
+  }
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "stack_pool.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace stack_utils {
+  /**
+   * @brief Walk many stacks at the same time, to hide the latency of memory.
+   *
+   * Visiting a single stack is a chain of dependent loads: the address of a
+   * node is known only after the previous one is loaded, therefore a cache
+   * miss cannot overlap with the next one. Here `group` stacks are advanced
+   * in round-robin, one node at a time, and each node is prefetched as soon
+   * as its address is known (asynchronous memory access chaining). When the
+   * walk gets back to a stack, its node is hopefully already in the cache,
+   * and up to `group` cache misses are served at the same time.
+   *
+   * `step(i, x)` is called on each node `x` of the stack `heads[i]`, from top
+   * to bottom, and returns whether the walk of that stack should go on. The
+   * nodes of a stack are visited in order, but the visits of different
+   * stacks are interleaved.
+   *
+   * This function throws an exception if some head is not a valid index in
+   * the pool.
+   *
+   * @tparam P Type of the stack pool (possibly const).
+   * @tparam H Type of the heads.
+   * @tparam Step A callable object taking an index and a head, returning a
+   *            bool.
+   * @param pool Stack pool containing the stacks.
+   * @param heads Heads of the stacks to be visited.
+   * @param step
+   * @param group Number of stacks walked at the same time.
+   */
+  template <typename P, typename H, typename Step>
+  void batched_walk(P& pool,
+                    const std::vector<H>& heads,
+                    Step step,
+                    std::size_t group = 16) {
+    struct slot {
+      std::size_t index;
+      H node;
+    };
+    std::vector<slot> slots;
+    slots.reserve(group);
+
+    std::size_t next_head = 0;
+    // start the walk of the next non-empty stack in the given slot
+    auto refill = [&](slot& s) {
+      while (next_head < heads.size() && pool.empty(heads[next_head]))
+        ++next_head;
+      if (next_head == heads.size())
+        return false;
+      s = slot{next_head, heads[next_head]};
+      pool.prefetch(s.node);
+      ++next_head;
+      return true;
+    };
+
+    // read-only access, which is never recorded in the undo log of the pool
+    const P& cpool = pool;
+
+    slot s;
+    while (slots.size() < std::max<std::size_t>(group, 1) && refill(s))
+      slots.push_back(s);
+
+    while (!slots.empty()) {
+      for (std::size_t k = 0; k < slots.size(); ++k) {
+        slot& current = slots[k];
+        current.node = step(current.index, current.node)
+                           ? cpool.next(current.node)
+                           : pool.end();
+
+        if (!pool.empty(current.node)) {
+          pool.prefetch(current.node);
+        } else if (!refill(current)) {
+          // no more stacks, the group shrinks
+          current = slots.back();
+          slots.pop_back();
+          --k;
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Compute the size of each of the given stacks, walking `group`
+   * stacks at the same time (see batched_walk). The stacks are not modified.
+   *
+   * @tparam value_type Type of the values held in the stack pool.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @param pool Stack pool containing the stacks.
+   * @param heads Heads of the stacks to be measured.
+   * @param group Number of stacks walked at the same time.
+   * @return std::vector<std::size_t> The size of `heads[i]` at index `i`.
+   */
+  template <typename value_type, typename stack_type>
+  std::vector<std::size_t> batched_stack_sizes(
+      const stack_pool<value_type, stack_type>& pool,
+      const std::vector<stack_type>& heads,
+      std::size_t group = 16) {
+    std::vector<std::size_t> sizes(heads.size(), 0);
+    batched_walk(pool, heads,
+                 [&sizes](std::size_t i, stack_type) {
+                   ++sizes[i];
+                   return true;
+                 },
+                 group);
+    return sizes;
+  }
+
+  /**
+   * @brief Find the first node (from the top) of each of the given stacks
+   * whose value satisfies `pred`, walking `group` stacks at the same time
+   * (see batched_walk). The stacks are not modified.
+   *
+   * @tparam value_type Type of the values held in the stack pool.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @tparam Pred A callable object taking a `const value_type&` and
+   *            returning a bool.
+   * @param pool Stack pool containing the stacks.
+   * @param heads Heads of the stacks to be searched.
+   * @param pred
+   * @param group Number of stacks walked at the same time.
+   * @return std::vector<stack_type> The node found in `heads[i]` at index
+   *            `i`, or `pool.end()` if there is no such node.
+   */
+  template <typename value_type, typename stack_type, typename Pred>
+  std::vector<stack_type> batched_find_if(
+      const stack_pool<value_type, stack_type>& pool,
+      const std::vector<stack_type>& heads,
+      Pred pred,
+      std::size_t group = 16) {
+    std::vector<stack_type> found(heads.size(), pool.end());
+    batched_walk(pool, heads,
+                 [&](std::size_t i, stack_type x) {
+                   if (!pred(pool.value(x)))
+                     return true;
+                   found[i] = x;
+                   return false;
+                 },
+                 group);
+    return found;
+  }
+
+  /**
+   * @brief Call `f(i, value)` on each value of the stack `heads[i]`, for each
+   * `i`, walking `group` stacks at the same time (see batched_walk).
+   *
+   * @tparam P Type of the stack pool (possibly const).
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @tparam F A callable object taking an index and a reference to a value
+   *            (const if the pool is const).
+   * @param pool Stack pool containing the stacks.
+   * @param heads Heads of the stacks to be visited.
+   * @param f
+   * @param group Number of stacks walked at the same time.
+   */
+  template <typename P, typename stack_type, typename F>
+  void batched_for_each(P& pool,
+                        const std::vector<stack_type>& heads,
+                        F f,
+                        std::size_t group = 16) {
+    batched_walk(pool, heads,
+                 [&](std::size_t i, stack_type x) {
+                   f(i, pool.value(x));
+                   return true;
+                 },
+                 group);
+  }
+}  // namespace stack_utils
@@ -0,0 +1,65 @@
+#include "augmented_stack_pool.hpp"
+#include "bench_utils.hpp"
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+// a mix of pushes, pops and "minimum of this stack" queries
+template <typename Pool, typename Query>
+double run(Pool& pool,
+           std::size_t n_stacks,
+           std::size_t n_ops,
+           unsigned query_percent,
+           Query query) {
+  std::vector<std::uint32_t> heads(n_stacks, pool.end());
+  std::mt19937 gen{42};
+  std::int64_t acc = 0;
+  double t = bench::time_it([&]() {
+    for (std::size_t i = 0; i < n_ops; ++i) {
+      auto s = gen() % n_stacks;
+      auto dice = gen() % 100;
+      if (dice < query_percent)
+        acc += query(pool, heads[s]);
+      else if (dice % 4 == 0 && !pool.empty(heads[s]))
+        heads[s] = pool.pop(heads[s]);
+      else
+        heads[s] = pool.push(std::int64_t(gen() % 1000000), heads[s]);
+    }
+  });
+  bench::do_not_optimize(acc);
+  return t;
+}
+
+int main(int argc, char** argv) {
+  const std::size_t n_stacks = bench::arg(argc, argv, 1, 256);
+  const std::size_t n_ops = bench::arg(argc, argv, 2, 200000);
+
+  std::cout << "pool,query_percent,stacks,operations,seconds,ns_per_op"
+            << std::endl;
+  for (unsigned q : {0u, 10u, 50u, 90u}) {
+    stack_pool<std::int64_t, std::uint32_t> plain;
+    double t_plain = run(plain, n_stacks, n_ops, q,
+                         [](const auto& p, std::uint32_t h) {
+                           auto m = std::numeric_limits<std::int64_t>::max();
+                           p.for_each(h, [&m](std::int64_t x) {
+                             m = x < m ? x : m;
+                           });
+                           return m;
+                         });
+    std::cout << "stack_pool," << q << ',' << n_stacks << ',' << n_ops << ','
+              << t_plain << ',' << t_plain * 1e9 / n_ops << std::endl;
+
+    augmented_stack_pool<std::int64_t, monoids::min<std::int64_t>,
+                         std::uint32_t>
+        augmented;
+    double t_aug = run(augmented, n_stacks, n_ops, q,
+                       [](const auto& p, std::uint32_t h) {
+                         return p.aggregate(h);
+                       });
+    std::cout << "augmented_stack_pool," << q << ',' << n_stacks << ','
+              << n_ops << ',' << t_aug << ',' << t_aug * 1e9 / n_ops
+              << std::endl;
+  }
+}
@@ -0,0 +1,62 @@
+#include "batched_traversal.hpp"
+#include "bench_utils.hpp"
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv) {
+  // 16 bytes per node: the default pool takes 512 MB, which should be much
+  // larger than the last-level cache
+  const std::size_t n_nodes = bench::arg(argc, argv, 1, 1 << 25);
+  const std::size_t n_stacks = bench::arg(argc, argv, 2, 1 << 16);
+
+  stack_pool<std::int64_t, std::uint64_t> pool{n_nodes};
+  std::vector<std::uint64_t> heads(n_stacks, pool.end());
+  // nodes are pushed to random stacks, so that consecutive nodes of a stack
+  // are far away in the pool
+  std::mt19937_64 gen{42};
+  for (std::size_t i = 0; i < n_nodes; ++i) {
+    auto s = gen() % n_stacks;
+    heads[s] = pool.push(std::int64_t(i), heads[s]);
+  }
+  const auto& cpool = pool;
+
+  std::cout << "function,group,nodes,stacks,seconds,ns_per_node,speedup"
+            << std::endl;
+  auto print = [&](const char* name, std::size_t g, double t, double base) {
+    std::cout << name << ',' << g << ',' << n_nodes << ',' << n_stacks << ','
+              << t << ',' << t * 1e9 / n_nodes << ',' << base / t << std::endl;
+  };
+
+  double chain = bench::time_it([&]() {
+    std::size_t total = 0;
+    for (auto h : heads)
+      total += stack_utils::stack_size(cpool, h);
+    bench::do_not_optimize(total);
+  });
+  print("stack_size", 1, chain, chain);
+
+  for (std::size_t g = 1; g <= 128; g *= 2) {
+    print("batched_stack_sizes", g, bench::time_it([&]() {
+            auto sizes = stack_utils::batched_stack_sizes(cpool, heads, g);
+            bench::do_not_optimize(sizes);
+          }),
+          chain);
+    print("batched_for_each", g, bench::time_it([&]() {
+            std::int64_t sum = 0;
+            stack_utils::batched_for_each(
+                cpool, heads,
+                [&sum](std::size_t, const std::int64_t& x) { sum += x; }, g);
+            bench::do_not_optimize(sum);
+          }),
+          chain);
+    print("batched_find_if", g, bench::time_it([&]() {
+            auto found = stack_utils::batched_find_if(
+                cpool, heads, [](std::int64_t x) { return x < 0; }, g);
+            bench::do_not_optimize(found);
+          }),
+          chain);
+  }
+}
@@ -0,0 +1,60 @@
+#include "bench_utils.hpp"
+#include "parallel_utils.hpp"
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+// build stacks from (stack_id, value) pairs, with parallel_bulk_build on an
+// increasing number of threads and with a serial loop of push
+int main(int argc, char** argv) {
+  const std::size_t n_stacks = bench::arg(argc, argv, 1, 10000);
+  const std::size_t n_pairs = bench::arg(argc, argv, 2, 1 << 22);
+  const std::size_t max_threads = bench::arg(argc, argv, 3, 64);
+
+  std::vector<std::pair<std::uint32_t, std::int64_t>> pairs(n_pairs);
+  std::mt19937 gen{42};
+  for (std::size_t i = 0; i < n_pairs; ++i)
+    pairs[i] = {std::uint32_t(gen() % n_stacks), std::int64_t(i)};
+
+  // traversing the result shows the effect of the contiguous layout
+  auto traverse = [n_stacks](const auto& pool, const auto& heads) {
+    std::int64_t sum = 0;
+    for (std::size_t s = 0; s < n_stacks; ++s)
+      pool.for_each(heads[s], [&sum](std::int64_t x) { sum += x; });
+    bench::do_not_optimize(sum);
+  };
+
+  std::cout << "method,threads,stacks,pairs,seconds,speedup,traversal_seconds"
+            << std::endl;
+  double serial = 0;
+  {
+    stack_pool<std::int64_t, std::uint32_t> pool;
+    std::vector<std::uint32_t> heads(n_stacks, pool.end());
+    serial = bench::time_it([&]() {
+      pool.reserve(n_pairs);
+      for (const auto& p : pairs)
+        heads[p.first] = pool.push(p.second, heads[p.first]);
+    });
+    std::cout << "push,1," << n_stacks << ',' << n_pairs << ',' << serial
+              << ",1," << bench::time_it([&]() { traverse(pool, heads); })
+              << std::endl;
+  }
+
+  for (std::size_t t = 1; t <= max_threads; t *= 2) {
+    work_stealing_pool tp{t};
+    std::pair<stack_pool<std::int64_t, std::uint32_t>,
+              std::vector<std::uint32_t>>
+        built;
+    double s = bench::time_it([&]() {
+      built = stack_utils::parallel_bulk_build<std::int64_t, std::uint32_t>(
+          tp, pairs.begin(), pairs.end(), n_stacks);
+    });
+    std::cout << "parallel_bulk_build," << t << ',' << n_stacks << ','
+              << n_pairs << ',' << s << ',' << serial / s << ','
+              << bench::time_it(
+                     [&]() { traverse(built.first, built.second); })
+              << std::endl;
+  }
+}
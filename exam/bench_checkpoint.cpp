@@ -0,0 +1,76 @@
+#include "bench_utils.hpp"
+#include "stack_pool.hpp"
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using pool_type = stack_pool<std::int64_t, std::uint32_t>;
+
+// a speculative batch of random pushes and pops
+void apply_batch(pool_type& pool,
+                 std::vector<std::uint32_t>& heads,
+                 std::size_t batch,
+                 std::mt19937& gen) {
+  for (std::size_t i = 0; i < batch; ++i) {
+    auto& h = heads[gen() % heads.size()];
+    if (gen() % 2 == 0 || pool.empty(h))
+      h = pool.push(std::int64_t(i), h);
+    else
+      h = pool.pop(h);
+  }
+}
+
+int main(int argc, char** argv) {
+  const std::size_t max_size = bench::arg(argc, argv, 1, 1 << 20);
+  const std::size_t reps = bench::arg(argc, argv, 2, 20);
+  const std::size_t n_stacks = 1024;
+
+  std::cout << "method,pool_size,batch,us_per_batch" << std::endl;
+  for (std::size_t size = 1 << 14; size <= max_size; size *= 8) {
+    for (std::size_t batch : {10, 1000, 100000}) {
+      pool_type pool{size};
+      std::vector<std::uint32_t> heads(n_stacks, pool.end());
+      std::mt19937 gen{42};
+      for (std::size_t i = 0; i < size; ++i)
+        heads[i % n_stacks] = pool.push(std::int64_t(i), heads[i % n_stacks]);
+
+      auto report = [&](const std::string& method, double t) {
+        std::cout << method << ',' << size << ',' << batch << ','
+                  << t * 1e6 / reps << std::endl;
+      };
+
+      report("copy", bench::time_it([&]() {
+               for (std::size_t r = 0; r < reps; ++r) {
+                 pool_type backup = pool;
+                 auto saved_heads = heads;
+                 apply_batch(pool, heads, batch, gen);
+                 pool = std::move(backup);
+                 heads = std::move(saved_heads);
+               }
+             }));
+
+      // room for the pushes, so that the batch does not reallocate the pool
+      pool.reserve(size + batch);
+      report("checkpoint", bench::time_it([&]() {
+               for (std::size_t r = 0; r < reps; ++r) {
+                 pool.checkpoint();
+                 auto saved_heads = heads;
+                 apply_batch(pool, heads, batch, gen);
+                 pool.rollback();
+                 heads = std::move(saved_heads);
+               }
+             }));
+
+      // the cost of the batch alone, without any way to undo it
+      pool_type scratch = pool;
+      scratch.reserve(size + batch * reps);
+      auto scratch_heads = heads;
+      report("no_undo", bench::time_it([&]() {
+               for (std::size_t r = 0; r < reps; ++r)
+                 apply_batch(scratch, scratch_heads, batch, gen);
+             }));
+    }
+  }
+}
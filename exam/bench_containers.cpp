@@ -0,0 +1,184 @@
+#include "bench_utils.hpp"
+#include "stack_pool.hpp"
+#include <array>
+#include <cstdint>
+#include <forward_list>
+#include <iostream>
+#include <random>
+#include <stack>
+#include <string>
+#include <vector>
+
+// push, traversal, pop, free_stack and random churn on many stacks, with
+// stack_pool<T, N> and with the standard containers
+
+template <std::size_t Size>
+struct item {
+  std::int64_t key;
+  std::array<char, Size - sizeof(std::int64_t)> payload;
+
+  item(std::int64_t k = 0) : key{k}, payload{} {}
+};
+
+inline std::int64_t key(std::int64_t x) { return x; }
+template <std::size_t Size>
+std::int64_t key(const item<Size>& x) {
+  return x.key;
+}
+
+// each adapter manages `k` stacks with the same interface
+
+template <typename T, typename N>
+struct pool_stacks {
+  stack_pool<T, N> pool;
+  std::vector<N> heads;
+
+  explicit pool_stacks(std::size_t k) : heads(k, pool.end()) {}
+  void push(std::size_t i, const T& v) { heads[i] = pool.push(v, heads[i]); }
+  void pop(std::size_t i) { heads[i] = pool.pop(heads[i]); }
+  bool empty(std::size_t i) const { return pool.empty(heads[i]); }
+  std::int64_t sum(std::size_t i) const {
+    std::int64_t s = 0;
+    pool.for_each(heads[i], [&s](const T& x) { s += key(x); });
+    return s;
+  }
+  void clear(std::size_t i) { heads[i] = pool.free_stack(heads[i]); }
+};
+
+template <typename T>
+struct std_stacks {
+  // std::stack does not expose its elements, but its container is protected
+  struct iterable_stack : std::stack<T, std::vector<T>> {
+    using std::stack<T, std::vector<T>>::c;
+  };
+  std::vector<iterable_stack> stacks;
+
+  explicit std_stacks(std::size_t k) : stacks(k) {}
+  void push(std::size_t i, const T& v) { stacks[i].push(v); }
+  void pop(std::size_t i) { stacks[i].pop(); }
+  bool empty(std::size_t i) const { return stacks[i].empty(); }
+  std::int64_t sum(std::size_t i) const {
+    std::int64_t s = 0;
+    for (auto it = stacks[i].c.rbegin(); it != stacks[i].c.rend(); ++it)
+      s += key(*it);
+    return s;
+  }
+  void clear(std::size_t i) { stacks[i].c.clear(); }
+};
+
+template <typename T>
+struct list_stacks {
+  std::vector<std::forward_list<T>> lists;
+
+  explicit list_stacks(std::size_t k) : lists(k) {}
+  void push(std::size_t i, const T& v) { lists[i].push_front(v); }
+  void pop(std::size_t i) { lists[i].pop_front(); }
+  bool empty(std::size_t i) const { return lists[i].empty(); }
+  std::int64_t sum(std::size_t i) const {
+    std::int64_t s = 0;
+    for (const auto& x : lists[i])
+      s += key(x);
+    return s;
+  }
+  void clear(std::size_t i) { lists[i].clear(); }
+};
+
+template <typename T>
+struct vector_stacks {
+  std::vector<std::vector<T>> vectors;
+
+  explicit vector_stacks(std::size_t k) : vectors(k) {}
+  void push(std::size_t i, const T& v) { vectors[i].push_back(v); }
+  void pop(std::size_t i) { vectors[i].pop_back(); }
+  bool empty(std::size_t i) const { return vectors[i].empty(); }
+  std::int64_t sum(std::size_t i) const {
+    std::int64_t s = 0;
+    for (auto it = vectors[i].rbegin(); it != vectors[i].rend(); ++it)
+      s += key(*it);
+    return s;
+  }
+  void clear(std::size_t i) { vectors[i].clear(); }
+};
+
+template <typename Stacks, typename T>
+void run(const std::string& container,
+         const std::string& index,
+         std::size_t n,
+         std::size_t k,
+         std::size_t reps) {
+  // the same random sequence of stacks for all the containers
+  std::mt19937 gen{42};
+  std::vector<std::uint32_t> which(n);
+  for (auto& w : which)
+    w = gen() % k;
+
+  double t[5] = {};
+  std::int64_t acc = 0;
+  for (std::size_t r = 0; r < reps; ++r) {
+    Stacks s(k);
+    t[0] += bench::time_it([&]() {
+      for (std::size_t i = 0; i < n; ++i)
+        s.push(which[i], T(std::int64_t(i)));
+    });
+    t[1] += bench::time_it([&]() {
+      for (std::size_t i = 0; i < k; ++i)
+        acc += s.sum(i);
+    });
+    t[2] += bench::time_it([&]() {
+      for (std::size_t i = 0; i < k; ++i)
+        while (!s.empty(i))
+          s.pop(i);
+    });
+
+    for (std::size_t i = 0; i < n; ++i)
+      s.push(which[i], T(std::int64_t(i)));
+    t[3] += bench::time_it([&]() {
+      for (std::size_t i = 0; i < k; ++i)
+        s.clear(i);
+    });
+
+    // half of the nodes are in the stacks, then random pushes and pops
+    for (std::size_t i = 0; i < n / 2; ++i)
+      s.push(which[i], T(std::int64_t(i)));
+    t[4] += bench::time_it([&]() {
+      for (std::size_t i = 0; i < n / 2; ++i) {
+        auto w = which[(i * 7) % n];
+        if (which[i] % 2 == 0 || s.empty(w))
+          s.push(w, T(std::int64_t(i)));
+        else
+          s.pop(w);
+      }
+    });
+  }
+  bench::do_not_optimize(acc);
+
+  const char* operations[5] = {"push", "traversal", "pop", "free_stack",
+                               "churn"};
+  const std::size_t ops[5] = {n, n, n, n, n / 2};
+  for (int i = 0; i < 5; ++i)
+    std::cout << container << ',' << index << ',' << sizeof(T) << ','
+              << operations[i] << ',' << n << ',' << k << ','
+              << t[i] * 1e9 / (ops[i] * reps) << std::endl;
+}
+
+template <typename T>
+void compare(std::size_t n, std::size_t k, std::size_t reps) {
+  run<pool_stacks<T, std::uint16_t>, T>("stack_pool", "uint16", n, k, reps);
+  run<pool_stacks<T, std::uint32_t>, T>("stack_pool", "uint32", n, k, reps);
+  run<pool_stacks<T, std::uint64_t>, T>("stack_pool", "uint64", n, k, reps);
+  run<std_stacks<T>, T>("std::stack<std::vector>", "-", n, k, reps);
+  run<list_stacks<T>, T>("std::forward_list", "-", n, k, reps);
+  run<vector_stacks<T>, T>("std::vector<std::vector>", "-", n, k, reps);
+}
+
+int main(int argc, char** argv) {
+  // uint16_t addresses at most 65535 nodes
+  const std::size_t n = bench::arg(argc, argv, 1, 60000);
+  const std::size_t k = bench::arg(argc, argv, 2, 256);
+  const std::size_t reps = bench::arg(argc, argv, 3, 20);
+
+  std::cout << "container,index,value_bytes,operation,values,stacks,ns_per_op"
+            << std::endl;
+  compare<std::int64_t>(n, k, reps);
+  compare<item<128>>(n, k, reps);
+}
@@ -0,0 +1,85 @@
+#include "bench_utils.hpp"
+#include "fork_snapshot.hpp"
+#include "stack_pool.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// pause of the writers, duration and copy-on-write overhead of a snapshot of
+// a stack_pool written by a child process (fork_snapshot), while the parent
+// is idle, writes values of random nodes, or pushes new nodes. A blocking
+// save, during which the writers are paused, is the baseline
+
+const std::string path = "bench_fork_snapshot.tmp";
+
+using pool_type = stack_pool<std::int64_t, std::uint32_t>;
+
+void blocking_save(const pool_type& pool) {
+  const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  stack_utils::detail::fd_streambuf buffer{fd};
+  std::ostream os{&buffer};
+  pool.save(os);
+  os.flush();
+  ::fsync(fd);
+  ::close(fd);
+}
+
+int main(int argc, char** argv) {
+  const std::size_t n = bench::arg(argc, argv, 1, 1 << 23);
+  const std::size_t n_stacks = bench::arg(argc, argv, 2, 4096);
+
+  // extra capacity for the pushes made during the snapshots
+  pool_type pool{2 * n};
+  std::vector<std::uint32_t> heads(n_stacks, pool.end());
+  std::mt19937_64 gen{42};
+  for (std::size_t i = 0; i < n; ++i) {
+    const std::size_t s = gen() % n_stacks;
+    heads[s] = pool.push(std::int64_t(i), heads[s]);
+  }
+
+  std::cout << "mode,nodes,pool_mb,pause_ms,snapshot_s,cow_mb,"
+               "parent_ops,parent_mops_per_s"
+            << std::endl;
+  const double mb = double(pool.stats().bytes_used) / (1 << 20);
+
+  const double blocking = bench::time_it([&]() { blocking_save(pool); });
+  std::cout << "blocking_save," << n << ',' << mb << ',' << blocking * 1e3
+            << ',' << blocking << ",0,0,0" << std::endl;
+
+  for (std::string mode : {"idle", "random_writes", "pushes"}) {
+    std::size_t ops = 0;
+    const auto t0 = bench::clock::now();
+    fork_snapshot s{path, [&pool](std::ostream& os) { pool.save(os); }};
+    if (mode == "idle") {
+      s.wait();
+    } else {
+      // the parent works in batches, and checks in between whether the
+      // child is done
+      while (!s.done()) {
+        for (std::size_t k = 0; k < 4096; ++k) {
+          const std::uint64_t r = gen();
+          if (mode == "random_writes") {
+            pool.value(std::uint32_t(r % n + 1)) += 1;
+          } else if (ops + k < n) {
+            const std::size_t h = r % n_stacks;
+            heads[h] = pool.push(std::int64_t(r), heads[h]);
+          }
+        }
+        ops += 4096;
+      }
+    }
+    const double parent_seconds = bench::seconds_since(t0);
+    const fork_snapshot_stats stats = s.wait();
+    std::cout << mode << ',' << n << ',' << mb << ','
+              << stats.pause_seconds * 1e3 << ',' << stats.seconds << ','
+              << double(stats.cow_bytes) / (1 << 20) << ',' << ops << ','
+              << ops / parent_seconds * 1e-6 << std::endl;
+  }
+  std::remove(path.c_str());
+}
@@ -0,0 +1,97 @@
+#include "bench_utils.hpp"
+#include "frozen_stacks.hpp"
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+// traversal of all the stacks of a pool where they are scattered, of their
+// frozen copy, and of the pool built by thaw
+int main(int argc, char** argv) {
+  const std::size_t n_stacks = bench::arg(argc, argv, 1, 10000);
+  const std::size_t max_nodes = bench::arg(argc, argv, 2, 1 << 22);
+  const std::size_t reps = bench::arg(argc, argv, 3, 5);
+
+  std::cout << "method,nodes,stacks,seconds,ns_per_value" << std::endl;
+  for (std::size_t n = 1 << 16; n <= max_nodes; n *= 4) {
+    stack_pool<double, std::uint32_t> pool{n};
+    std::vector<std::uint32_t> heads(n_stacks, pool.end());
+    std::mt19937 gen{42};
+    std::uniform_real_distribution<double> skew{0, 1};
+    for (std::size_t i = 0; i < n; ++i) {
+      auto s = static_cast<std::size_t>(n_stacks * std::pow(skew(gen), 3));
+      heads[s] = pool.push(double(i % 1000), heads[s]);
+    }
+    const auto& cpool = pool;
+
+    auto report = [&](const std::string& method, double t, std::size_t r) {
+      std::cout << method << ',' << n << ',' << n_stacks << ',' << t / r
+                << ',' << t * 1e9 / (n * r) << std::endl;
+    };
+
+    frozen_stacks<double> frozen;
+    report("freeze", bench::time_it([&]() {
+             frozen = stack_utils::freeze(cpool, heads);
+           }),
+           1);
+    std::pair<stack_pool<double, std::uint32_t>, std::vector<std::uint32_t>>
+        thawed;
+    report("thaw", bench::time_it([&]() {
+             thawed = stack_utils::thaw<std::uint32_t>(frozen);
+           }),
+           1);
+
+    double sum = 0;
+    report("pool_for_each", bench::time_it([&]() {
+             for (std::size_t r = 0; r < reps; ++r)
+               for (auto h : heads)
+                 cpool.for_each(h, [&sum](double x) { sum += x; });
+           }),
+           reps);
+    report("pool_batched_for_each", bench::time_it([&]() {
+             for (std::size_t r = 0; r < reps; ++r)
+               stack_utils::batched_for_each(
+                   cpool, heads,
+                   [&sum](std::size_t, double x) { sum += x; });
+           }),
+           reps);
+    report("thawed_for_each", bench::time_it([&]() {
+             const auto& p = thawed.first;
+             for (std::size_t r = 0; r < reps; ++r)
+               for (auto h : thawed.second)
+                 p.for_each(h, [&sum](double x) { sum += x; });
+           }),
+           reps);
+    report("frozen_accumulate", bench::time_it([&]() {
+             for (std::size_t r = 0; r < reps; ++r)
+               for (std::size_t i = 0; i < frozen.size(); ++i)
+                 sum = std::accumulate(frozen.begin(i), frozen.end(i), sum);
+           }),
+           reps);
+    // without a dependency on the previous sum the compiler vectorizes
+    report("frozen_vectorized", bench::time_it([&]() {
+             for (std::size_t r = 0; r < reps; ++r) {
+               for (std::size_t i = 0; i < frozen.size(); ++i) {
+                 double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+                 const double* x = frozen.begin(i);
+                 const std::size_t len = frozen.length(i);
+                 std::size_t k = 0;
+                 for (; k + 4 <= len; k += 4) {
+                   s0 += x[k];
+                   s1 += x[k + 1];
+                   s2 += x[k + 2];
+                   s3 += x[k + 3];
+                 }
+                 for (; k < len; ++k)
+                   s0 += x[k];
+                 sum += (s0 + s1) + (s2 + s3);
+               }
+             }
+           }),
+           reps);
+    bench::do_not_optimize(sum);
+  }
+}
@@ -0,0 +1,97 @@
+#include "bench_utils.hpp"
+#include "stack_pool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// a stack stored by hand, without stack_pool
+struct raw_node {
+  std::int64_t value;
+  std::uint32_t next;
+};
+
+int main(int argc, char** argv) {
+  const std::size_t n_nodes = bench::arg(argc, argv, 1, 1 << 20);
+  const std::size_t repetitions = bench::arg(argc, argv, 2, 20);
+
+  std::cout << "loop,layout,nodes,ns_per_node" << std::endl;
+  for (bool shuffled : {false, true}) {
+    // the nodes of the stack are either consecutive or scattered in the pool
+    std::vector<std::uint32_t> order(n_nodes);
+    std::iota(order.begin(), order.end(), 1);
+    if (shuffled)
+      std::shuffle(order.begin(), order.end(), std::mt19937{42});
+
+    std::vector<raw_node> raw(n_nodes);
+    std::uint32_t raw_head = 0;
+    for (auto x : order) {
+      raw[x - 1] = raw_node{std::int64_t(x), raw_head};
+      raw_head = x;
+    }
+
+    // same layout in a stack_pool, using n_nodes independent one-node stacks
+    // which are then freed in the right order
+    stack_pool<std::int64_t, std::uint32_t> pool{n_nodes};
+    for (std::size_t i = 0; i < n_nodes; ++i)
+      pool.push(0, pool.new_stack());
+    std::vector<std::uint32_t> reversed(order.rbegin(), order.rend());
+    for (auto x : reversed)
+      pool.pop(x);
+    auto head = pool.new_stack();
+    for (auto x : order)
+      head = pool.push(std::int64_t(x), head);
+    const auto& cpool = pool;
+
+    auto run = [&](const char* name, auto f) {
+      double t = bench::time_it([&]() {
+        std::int64_t sum = 0;
+        for (std::size_t r = 0; r < repetitions; ++r)
+          sum += f();
+        bench::do_not_optimize(sum);
+      });
+      std::cout << name << ',' << (shuffled ? "scattered" : "consecutive")
+                << ',' << n_nodes << ',' << t * 1e9 / (n_nodes * repetitions)
+                << std::endl;
+    };
+
+    run("hand_written_raw", [&]() {
+      std::int64_t sum = 0;
+      for (auto x = raw_head; x != 0; x = raw[x - 1].next)
+        sum += raw[x - 1].value;
+      return sum;
+    });
+    run("hand_written_next_value", [&]() {
+      std::int64_t sum = 0;
+      for (auto x = head; x != cpool.end(); x = cpool.next(x))
+        sum += cpool.value(x);
+      return sum;
+    });
+    run("stack_iterator", [&]() {
+      std::int64_t sum = 0;
+      for (auto it = cpool.cbegin(head); it != cpool.cend(head); ++it)
+        sum += *it;
+      return sum;
+    });
+    run("stack_iterator_postfix", [&]() {
+      std::int64_t sum = 0;
+      for (auto it = cpool.cbegin(head); it != cpool.cend(head); it++)
+        sum += *it;
+      return sum;
+    });
+    run("unchecked_iterator", [&]() {
+      std::int64_t sum = 0;
+      for (auto it = cpool.unchecked_begin(head);
+           it != cpool.unchecked_end(head); ++it)
+        sum += *it;
+      return sum;
+    });
+    run("for_each", [&]() {
+      std::int64_t sum = 0;
+      cpool.for_each(head, [&sum](std::int64_t x) { sum += x; });
+      return sum;
+    });
+  }
+}
@@ -0,0 +1,51 @@
+#include "bench_utils.hpp"
+#include "jump_stack_pool.hpp"
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv) {
+  const std::size_t max_depth = bench::arg(argc, argv, 1, 1 << 22);
+  const std::size_t n_queries = bench::arg(argc, argv, 2, 200);
+
+  std::cout << "pool,depth,queries,ns_per_query,speedup" << std::endl;
+  for (std::size_t depth = 1024; depth <= max_depth; depth *= 4) {
+    stack_pool<std::int64_t, std::uint32_t> plain{depth};
+    jump_stack_pool<std::int64_t, std::uint32_t> jumps{depth};
+    auto l = plain.new_stack();
+    auto j = jumps.new_stack();
+    for (std::size_t i = 0; i < depth; ++i) {
+      l = plain.push(std::int64_t(i), l);
+      j = jumps.push(std::int64_t(i), j);
+    }
+
+    std::mt19937_64 gen{42};
+    std::vector<std::size_t> ks(n_queries);
+    for (auto& k : ks)
+      k = gen() % depth;
+
+    double t_plain = bench::time_it([&]() {
+      std::int64_t acc = 0;
+      for (auto k : ks) {
+        auto x = l;
+        for (std::size_t i = 0; i < k; ++i)
+          x = plain.next(x);
+        acc += plain.value(x);
+      }
+      bench::do_not_optimize(acc);
+    });
+    double t_jumps = bench::time_it([&]() {
+      std::int64_t acc = 0;
+      for (auto k : ks)
+        acc += jumps.at(j, k);
+      bench::do_not_optimize(acc);
+    });
+
+    std::cout << "linear_walk," << depth << ',' << n_queries << ','
+              << t_plain * 1e9 / n_queries << ",1" << std::endl;
+    std::cout << "jump_stack_pool," << depth << ',' << n_queries << ','
+              << t_jumps * 1e9 / n_queries << ',' << t_plain / t_jumps
+              << std::endl;
+  }
+}
@@ -0,0 +1,63 @@
+#include "bench_utils.hpp"
+#include "stack_pool.hpp"
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv) {
+  const std::size_t n_nodes = bench::arg(argc, argv, 1, 1 << 24);
+  const std::size_t n_stacks = bench::arg(argc, argv, 2, 1 << 14);
+
+  std::cout << "operation,tracked,nodes,live,seconds,ns_per_node" << std::endl;
+  for (bool tracked : {false, true}) {
+    stack_pool<std::int64_t, std::uint32_t> pool{n_nodes};
+    pool.track_liveness(tracked);
+    std::vector<std::uint32_t> heads(n_stacks, pool.end());
+    std::mt19937 gen{42};
+
+    auto print = [&](const char* name, double t) {
+      std::cout << name << ',' << tracked << ',' << n_nodes << ','
+                << pool.count_live() << ',' << t << ','
+                << t * 1e9 / n_nodes << std::endl;
+    };
+
+    print("push", bench::time_it([&]() {
+            for (std::size_t i = 0; i < n_nodes; ++i) {
+              auto s = gen() % n_stacks;
+              heads[s] = pool.push(std::int64_t(i), heads[s]);
+            }
+          }));
+    // leave some holes in the pool
+    print("pop_and_free_stack", bench::time_it([&]() {
+            for (std::size_t s = 0; s < n_stacks; s += 3)
+              heads[s] = pool.free_stack(heads[s]);
+            for (std::size_t s = 1; s < n_stacks; s += 3)
+              for (int k = 0; k < 100 && !pool.empty(heads[s]); ++k)
+                heads[s] = pool.pop(heads[s]);
+          }));
+
+    print("sum_walking_chains", bench::time_it([&]() {
+            std::int64_t sum = 0;
+            for (auto h : heads)
+              pool.for_each(h, [&sum](std::int64_t x) { sum += x; });
+            bench::do_not_optimize(sum);
+          }));
+    print("sum_for_each_live", bench::time_it([&]() {
+            std::int64_t sum = 0;
+            pool.for_each_live(
+                [&sum](std::uint32_t, std::int64_t x) { sum += x; });
+            bench::do_not_optimize(sum);
+          }));
+    print("count_walking_chains", bench::time_it([&]() {
+            std::size_t n = 0;
+            for (auto h : heads)
+              n += stack_utils::stack_size(pool, h);
+            bench::do_not_optimize(n);
+          }));
+    print("count_live", bench::time_it([&]() {
+            auto n = pool.count_live();
+            bench::do_not_optimize(n);
+          }));
+  }
+}
@@ -0,0 +1,85 @@
+#include "bench_utils.hpp"
+#include "stack_pool.hpp"
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// combine `parts` pools (e.g. built by different threads) into one, with
+// merge_from or by pushing again every value
+
+using pool_type = stack_pool<std::int64_t, std::uint32_t>;
+
+struct part {
+  pool_type pool;
+  std::vector<std::uint32_t> heads;
+};
+
+std::vector<part> build_parts(std::size_t size,
+                              std::size_t parts,
+                              std::size_t n_stacks) {
+  std::vector<part> v(parts);
+  std::mt19937 gen{42};
+  for (auto& p : v) {
+    p.pool.reserve(size / parts);
+    p.heads.assign(n_stacks, p.pool.end());
+    for (std::size_t i = 0; i < size / parts; ++i) {
+      auto& h = p.heads[gen() % n_stacks];
+      h = p.pool.push(std::int64_t(i), h);
+    }
+  }
+  return v;
+}
+
+int main(int argc, char** argv) {
+  const std::size_t max_size = bench::arg(argc, argv, 1, 1 << 22);
+  const std::size_t n_stacks = bench::arg(argc, argv, 2, 1024);
+
+  std::cout << "method,pool_size,parts,seconds,ns_per_node" << std::endl;
+  for (std::size_t size = 1 << 16; size <= max_size; size *= 4) {
+    for (std::size_t parts : {2, 16}) {
+      auto report = [&](const std::string& method, double t) {
+        std::cout << method << ',' << size << ',' << parts << ',' << t << ','
+                  << t * 1e9 / size << std::endl;
+      };
+
+      auto v = build_parts(size, parts, n_stacks);
+      pool_type merged;
+      std::vector<std::uint32_t> heads;
+      report("merge_from", bench::time_it([&]() {
+               merged.reserve(size);
+               for (auto& p : v) {
+                 auto translate = merged.merge_from(std::move(p.pool));
+                 for (auto h : p.heads)
+                   heads.push_back(translate(h));
+               }
+             }));
+      bench::do_not_optimize(heads.back());
+
+      // the order of each stack is kept by pushing its values from the
+      // bottom, therefore each stack is first copied to a buffer
+      v = build_parts(size, parts, n_stacks);
+      pool_type pushed;
+      heads.clear();
+      std::vector<std::int64_t> buffer;
+      report("push", bench::time_it([&]() {
+               pushed.reserve(size);
+               for (auto& p : v) {
+                 for (auto h : p.heads) {
+                   buffer.clear();
+                   p.pool.for_each(h, [&buffer](std::int64_t x) {
+                     buffer.push_back(x);
+                   });
+                   auto head = pushed.new_stack();
+                   for (auto it = buffer.rbegin(); it != buffer.rend(); ++it)
+                     head = pushed.push(*it, head);
+                   heads.push_back(head);
+                 }
+                 p.pool = pool_type{};
+               }
+             }));
+      bench::do_not_optimize(heads.back());
+    }
+  }
+}
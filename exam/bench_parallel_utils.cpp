@@ -0,0 +1,60 @@
+#include "bench_utils.hpp"
+#include "parallel_utils.hpp"
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv) {
+  const std::size_t n_stacks = bench::arg(argc, argv, 1, 10000);
+  const std::size_t n_nodes = bench::arg(argc, argv, 2, 1 << 22);
+  const std::size_t max_threads = bench::arg(argc, argv, 3, 64);
+
+  // nodes are pushed to random stacks, so stacks are scattered in the pool
+  // and have different lengths
+  stack_pool<double, std::uint32_t> pool{n_nodes};
+  std::vector<std::uint32_t> heads(n_stacks, pool.end());
+  std::mt19937 gen{42};
+  std::uniform_real_distribution<double> skew{0, 1};
+  for (std::size_t i = 0; i < n_nodes; ++i) {
+    auto s = static_cast<std::size_t>(n_stacks * std::pow(skew(gen), 3));
+    heads[s] = pool.push(double(i % 1000), heads[s]);
+  }
+  const auto& cpool = pool;
+
+  std::cout << "function,threads,stacks,nodes,seconds,speedup" << std::endl;
+  double base_sizes = 0, base_transform = 0, base_reduce = 0;
+  for (std::size_t t = 1; t <= max_threads; t *= 2) {
+    work_stealing_pool tp{t};
+    std::vector<std::size_t> sizes;
+
+    double s = bench::time_it([&]() {
+      sizes = stack_utils::parallel_stack_sizes(tp, cpool, heads);
+    });
+    double tr = bench::time_it([&]() {
+      auto out = stack_utils::parallel_transform(
+          tp, cpool, heads, [](double x) { return std::sqrt(x); }, sizes);
+      bench::do_not_optimize(out);
+    });
+    double r = bench::time_it([&]() {
+      auto sum = stack_utils::parallel_reduce(
+          tp, cpool, heads, 0.0, [](double a, double b) { return a + b; },
+          sizes);
+      bench::do_not_optimize(sum);
+    });
+
+    if (t == 1) {
+      base_sizes = s;
+      base_transform = tr;
+      base_reduce = r;
+    }
+    std::cout << "parallel_stack_sizes," << t << ',' << n_stacks << ','
+              << n_nodes << ',' << s << ',' << base_sizes / s << std::endl;
+    std::cout << "parallel_transform," << t << ',' << n_stacks << ','
+              << n_nodes << ',' << tr << ',' << base_transform / tr
+              << std::endl;
+    std::cout << "parallel_reduce," << t << ',' << n_stacks << ',' << n_nodes
+              << ',' << r << ',' << base_reduce / r << std::endl;
+  }
+}
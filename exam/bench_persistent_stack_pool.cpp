@@ -0,0 +1,91 @@
+#include "bench_utils.hpp"
+#include "persistent_stack_pool.hpp"
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// a version history: each step pushes (55%) or pops (45%) a small value and
+// records the former version, keeping the last `history` versions
+
+struct result {
+  double seconds;
+  std::size_t nodes;     // nodes in use at the end
+  std::size_t capacity;  // nodes allocated at the end
+};
+
+result run_copies(std::size_t steps, std::size_t history, unsigned range) {
+  stack_pool<std::int64_t, std::uint32_t> pool;
+  std::deque<std::uint32_t> versions;
+  std::vector<std::int64_t> buffer;
+  auto cur = pool.new_stack();
+  std::mt19937 gen{42};
+
+  double t = bench::time_it([&]() {
+    for (std::size_t i = 0; i < steps; ++i) {
+      // copying a stack means pushing all its values again
+      buffer.clear();
+      pool.for_each(cur, [&buffer](std::int64_t x) { buffer.push_back(x); });
+      auto copy = pool.new_stack();
+      for (auto it = buffer.rbegin(); it != buffer.rend(); ++it)
+        copy = pool.push(*it, copy);
+      versions.push_back(copy);
+
+      if (gen() % 100 < 55 || pool.empty(cur))
+        cur = pool.push(std::int64_t(gen() % range), cur);
+      else
+        cur = pool.pop(cur);
+
+      if (versions.size() > history) {
+        pool.free_stack(versions.front());
+        versions.pop_front();
+      }
+    }
+  });
+  return {t, pool.count_live(), pool.capacity()};
+}
+
+template <bool HashConsing>
+result run_persistent(std::size_t steps, std::size_t history, unsigned range) {
+  persistent_stack_pool<std::int64_t, std::uint32_t, HashConsing> pool;
+  std::deque<std::uint32_t> versions;
+  auto cur = pool.new_stack();
+  std::mt19937 gen{42};
+
+  double t = bench::time_it([&]() {
+    for (std::size_t i = 0; i < steps; ++i) {
+      // O(1), the versions share their nodes
+      versions.push_back(pool.copy(cur));
+
+      if (gen() % 100 < 55 || pool.empty(cur))
+        cur = pool.push(std::int64_t(gen() % range), cur);
+      else
+        cur = pool.pop(cur);
+
+      if (versions.size() > history) {
+        pool.free_stack(versions.front());
+        versions.pop_front();
+      }
+    }
+  });
+  return {t, pool.count_nodes(), pool.capacity()};
+}
+
+int main(int argc, char** argv) {
+  const std::size_t steps = bench::arg(argc, argv, 1, 20000);
+  const std::size_t history = bench::arg(argc, argv, 2, 1000);
+  const unsigned range = bench::arg(argc, argv, 3, 4);
+
+  std::cout << "pool,steps,history,seconds,ns_per_step,nodes,capacity"
+            << std::endl;
+  auto print = [&](const char* name, result r) {
+    std::cout << name << ',' << steps << ',' << history << ',' << r.seconds
+              << ',' << r.seconds * 1e9 / steps << ',' << r.nodes << ','
+              << r.capacity << std::endl;
+  };
+  print("stack_pool_copies", run_copies(steps, history, range));
+  print("persistent", run_persistent<false>(steps, history, range));
+  print("persistent_hash_consing",
+        run_persistent<true>(steps, history, range));
+}
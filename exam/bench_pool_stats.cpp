@@ -0,0 +1,48 @@
+#include "bench_utils.hpp"
+#include "pool_stats.hpp"
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// the same operations with and without the event counters, to see their
+// cost. The statistics of the last pool are written as JSON on the standard
+// error
+int main(int argc, char** argv) {
+  const std::size_t size = bench::arg(argc, argv, 1, 1 << 22);
+  const std::size_t n_stacks = bench::arg(argc, argv, 2, 4096);
+
+  std::cout << "events_counted,operation,pool_size,seconds,ns_per_node"
+            << std::endl;
+  stack_pool_stats s;
+  std::vector<std::size_t> histogram;
+  for (bool counted : {false, true}) {
+    stack_pool<std::int64_t, std::uint32_t> pool;
+    pool.count_events(counted);
+    std::vector<std::uint32_t> heads(n_stacks, pool.end());
+    std::mt19937 gen{42};
+
+    auto report = [&](const char* operation, double t) {
+      std::cout << counted << ',' << operation << ',' << size << ',' << t
+                << ',' << t * 1e9 / size << std::endl;
+    };
+
+    report("push_pop", bench::time_it([&]() {
+             for (std::size_t i = 0; i < 2 * size; ++i) {
+               auto& h = heads[gen() % n_stacks];
+               if (i % 4 != 3 || pool.empty(h))
+                 h = pool.push(std::int64_t(i), h);
+               else
+                 h = pool.pop(h);
+             }
+           }));
+
+    report("stats", bench::time_it([&]() { s = pool.stats(); }));
+    report("histogram", bench::time_it([&]() {
+             histogram = stack_utils::stack_length_histogram(pool, heads);
+           }));
+  }
+
+  stack_utils::write_json(std::cerr, s, histogram);
+  std::cerr << std::endl;
+}
@@ -0,0 +1,79 @@
+#include "bench_utils.hpp"
+#include "prefetch_iterator.hpp"
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+template <std::size_t Bytes>
+struct payload {
+  std::uint64_t words[Bytes / sizeof(std::uint64_t)];
+  payload() = default;
+  explicit payload(std::uint64_t x) {
+    for (auto& w : words)
+      w = x++;
+  }
+};
+
+// the work done on each value is proportional to its size
+template <std::size_t Bytes>
+std::uint64_t process(const payload<Bytes>& p) {
+  std::uint64_t h = 0;
+  for (auto w : p.words)
+    h = (h ^ w) * 0x100000001b3;
+  return h;
+}
+
+template <typename Pool, typename H>
+double prefetched(const Pool& pool, const std::vector<H>& heads) {
+  return bench::time_it([&]() {
+    std::uint64_t h = 0;
+    for (auto head : heads)
+      for (auto it = stack_utils::prefetch_begin(pool, head);
+           it != stack_utils::prefetch_end(pool, head); ++it)
+        h += process(*it);
+    bench::do_not_optimize(h);
+  });
+}
+
+template <std::size_t Bytes>
+void run(std::size_t memory, std::size_t n_stacks) {
+  using pool_type = stack_pool<payload<Bytes>, std::uint64_t>;
+  const std::size_t n_nodes = memory / (Bytes + sizeof(std::uint64_t));
+
+  pool_type pool{n_nodes};
+  std::vector<std::uint64_t> heads(n_stacks, pool.end());
+  std::mt19937_64 gen{42};
+  for (std::size_t i = 0; i < n_nodes; ++i) {
+    auto s = gen() % n_stacks;
+    heads[s] = pool.push(payload<Bytes>{i}, heads[s]);
+  }
+  const auto& cpool = pool;
+
+  double plain = bench::time_it([&]() {
+    std::uint64_t h = 0;
+    for (auto head : heads)
+      for (auto it = cpool.cbegin(head); it != cpool.cend(head); ++it)
+        h += process(*it);
+    bench::do_not_optimize(h);
+  });
+
+  auto print = [&](const char* name, double t) {
+    std::cout << name << ',' << Bytes << ',' << n_nodes << ','
+              << t * 1e9 / n_nodes << ',' << plain / t << std::endl;
+  };
+  print("stack_iterator", plain);
+  print("prefetch_iterator", prefetched(cpool, heads));
+}
+
+int main(int argc, char** argv) {
+  const std::size_t memory = bench::arg(argc, argv, 1, 512) << 20;
+  const std::size_t n_stacks = bench::arg(argc, argv, 2, 1024);
+
+  std::cout << "iterator,value_bytes,nodes,ns_per_node,speedup"
+            << std::endl;
+  run<8>(memory, n_stacks);
+  run<64>(memory, n_stacks);
+  run<256>(memory, n_stacks);
+  run<1024>(memory, n_stacks);
+}
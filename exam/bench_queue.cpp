@@ -0,0 +1,97 @@
+#include "bench_utils.hpp"
+#include "concurrent_queue.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// what we used before mpmc_queue
+template <typename T>
+class locked_deque {
+  std::deque<T> q;
+  std::mutex m;
+
+ public:
+  explicit locked_deque(std::size_t) {}
+  bool push(const T& val) {
+    std::lock_guard<std::mutex> lock{m};
+    q.push_back(val);
+    return true;
+  }
+  bool pop(T& val) {
+    std::lock_guard<std::mutex> lock{m};
+    if (q.empty())
+      return false;
+    val = q.front();
+    q.pop_front();
+    return true;
+  }
+};
+
+std::uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             bench::clock::now().time_since_epoch())
+      .count();
+}
+
+// each value is the time at which it was pushed, consumers sample the time
+// spent by values in the queue
+template <typename Q>
+void run(const char* name, std::size_t pairs, std::size_t per_producer) {
+  Q q{1024};
+  const std::size_t total = pairs * per_producer;
+  std::atomic<std::size_t> popped{0};
+  std::vector<std::vector<double>> latencies(pairs);
+
+  auto t0 = bench::clock::now();
+  std::vector<std::thread> threads;
+  for (std::size_t p = 0; p < pairs; ++p)
+    threads.emplace_back([&q, per_producer]() {
+      for (std::size_t i = 0; i < per_producer; ++i)
+        while (!q.push(now_ns()))
+          std::this_thread::yield();
+    });
+  for (std::size_t c = 0; c < pairs; ++c)
+    threads.emplace_back([&q, &popped, &latencies, total, c]() {
+      std::uint64_t x;
+      std::size_t n = 0;
+      while (popped.load(std::memory_order_relaxed) < total) {
+        if (!q.pop(x)) {
+          std::this_thread::yield();
+          continue;
+        }
+        popped.fetch_add(1, std::memory_order_relaxed);
+        if (n++ % 16 == 0)
+          latencies[c].push_back(double(now_ns() - x));
+      }
+    });
+  for (auto& t : threads)
+    t.join();
+  double seconds = bench::seconds_since(t0);
+
+  std::vector<double> all;
+  for (auto& l : latencies)
+    all.insert(all.end(), l.begin(), l.end());
+
+  std::cout << name << ',' << pairs << ',' << total << ',' << seconds << ','
+            << total / seconds / 1e6 << ',' << bench::percentile(all, 0.5)
+            << ',' << bench::percentile(all, 0.99) << std::endl;
+}
+
+int main(int argc, char** argv) {
+  const std::size_t per_producer = bench::arg(argc, argv, 1, 100000);
+  const std::size_t max_pairs = bench::arg(argc, argv, 2, 32);
+
+  std::cout << "queue,pairs,values,seconds,mops_per_second,p50_latency_ns,"
+               "p99_latency_ns"
+            << std::endl;
+  for (std::size_t pairs = 1; pairs <= max_pairs; pairs *= 2) {
+    run<mpmc_queue<std::uint64_t>>("mpmc_queue", pairs, per_producer);
+    run<bounded_mpmc_queue<std::uint64_t>>("bounded_mpmc_queue", pairs,
+                                           per_producer);
+    run<locked_deque<std::uint64_t>>("locked_deque", pairs, per_producer);
+  }
+}
@@ -0,0 +1,37 @@
+#include "bench_utils.hpp"
+#include "stack_pool.hpp"
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// leak `leaked_percent`% of the stacks by losing their heads, then reclaim
+int main(int argc, char** argv) {
+  const std::size_t max_size = bench::arg(argc, argv, 1, 1 << 24);
+  const std::size_t n_stacks = bench::arg(argc, argv, 2, 4096);
+
+  std::cout << "pool_size,leaked_percent,reclaimed,seconds,ns_per_node"
+            << std::endl;
+  for (std::size_t size = 1 << 16; size <= max_size; size *= 4) {
+    for (unsigned leaked_percent : {0u, 10u, 90u}) {
+      stack_pool<std::int64_t, std::uint32_t> pool{size};
+      std::vector<std::uint32_t> heads(n_stacks, pool.end());
+      std::mt19937 gen{42};
+      for (std::size_t i = 0; i < size; ++i) {
+        auto& h = heads[gen() % n_stacks];
+        h = pool.push(std::int64_t(i), h);
+      }
+
+      std::vector<std::uint32_t> roots;
+      for (auto h : heads)
+        if (gen() % 100 >= leaked_percent)
+          roots.push_back(h);
+
+      std::size_t reclaimed = 0;
+      double t = bench::time_it(
+          [&]() { reclaimed = pool.reclaim_unreachable(roots); });
+      std::cout << size << ',' << leaked_percent << ',' << reclaimed << ','
+                << t << ',' << t * 1e9 / size << std::endl;
+    }
+  }
+}
@@ -0,0 +1,83 @@
+#include "bench_utils.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using pool_type = stack_pool<double, std::uint32_t>;
+
+// some work per stack, proportional to its length
+void process(const pool_type& pool, std::uint32_t head, double& out) {
+  double acc = 0;
+  for (auto it = pool.cbegin(head); it != pool.cend(head); ++it)
+    acc += std::sqrt(*it) * std::log1p(*it);
+  out = acc;
+}
+
+// each thread gets a contiguous chunk of heads
+double static_partition(const pool_type& pool,
+                        const std::vector<std::uint32_t>& heads,
+                        std::vector<double>& out,
+                        std::size_t n_threads) {
+  return bench::time_it([&]() {
+    std::vector<std::thread> threads;
+    std::size_t chunk = (heads.size() + n_threads - 1) / n_threads;
+    for (std::size_t t = 0; t < n_threads; ++t)
+      threads.emplace_back([&, t]() {
+        std::size_t last = std::min(heads.size(), (t + 1) * chunk);
+        for (std::size_t i = t * chunk; i < last; ++i)
+          process(pool, heads[i], out[i]);
+      });
+    for (auto& t : threads)
+      t.join();
+  });
+}
+
+double work_stealing(work_stealing_pool& tp,
+                     const pool_type& pool,
+                     const std::vector<std::uint32_t>& heads,
+                     std::vector<double>& out) {
+  const std::uint32_t* first = heads.data();
+  return bench::time_it([&]() {
+    tp.parallel_for_each_stack(pool, heads,
+                               [&out, first](const pool_type& p,
+                                             const std::uint32_t& h) {
+                                 process(p, h, out[&h - first]);
+                               });
+  });
+}
+
+int main(int argc, char** argv) {
+  const std::size_t n_stacks = bench::arg(argc, argv, 1, 4096);
+  const std::size_t max_threads = bench::arg(argc, argv, 2, 16);
+
+  // stack lengths follow a power law: few long stacks, many short ones. The
+  // long stacks are at the beginning, which is the worst case for a static
+  // partition.
+  pool_type pool;
+  std::vector<std::uint32_t> heads(n_stacks, pool.end());
+  std::mt19937 gen{42};
+  std::size_t nodes = 0;
+  for (std::size_t s = 0; s < n_stacks; ++s) {
+    std::size_t len = 200000 / (s + 1) + 1;
+    for (std::size_t i = 0; i < len; ++i)
+      heads[s] = pool.push(double(gen() % 1000), heads[s]);
+    nodes += len;
+  }
+
+  std::vector<double> out(n_stacks);
+  std::cout << "strategy,threads,stacks,nodes,seconds" << std::endl;
+  for (std::size_t t = 1; t <= max_threads; t *= 2) {
+    std::cout << "static_partition," << t << ',' << n_stacks << ',' << nodes
+              << ',' << static_partition(pool, heads, out, t) << std::endl;
+
+    work_stealing_pool tp{t};
+    std::cout << "work_stealing," << t << ',' << n_stacks << ',' << nodes
+              << ',' << work_stealing(tp, pool, heads, out) << std::endl;
+  }
+  bench::do_not_optimize(out);
+}
@@ -0,0 +1,76 @@
+#include "bench_utils.hpp"
+#include "stack_algorithms.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// a value of `Size` bytes, compared by its first 8 bytes
+template <std::size_t Size>
+struct item {
+  std::int64_t key;
+  std::array<char, Size - sizeof(std::int64_t)> payload;
+
+  item(std::int64_t k = 0) : key{k}, payload{} {}
+  bool operator<(const item& other) const { return key < other.key; }
+};
+
+// time `op` on a freshly built stack of `n` random values, `reps` times.
+// Returns the average time in seconds
+template <typename T, typename Op>
+double run(std::size_t n, std::size_t reps, Op op) {
+  double total = 0;
+  std::mt19937_64 gen{42};
+  for (std::size_t r = 0; r < reps; ++r) {
+    stack_pool<T, std::uint32_t> pool{n};
+    auto l = pool.new_stack();
+    for (std::size_t i = 0; i < n; ++i)
+      l = pool.push(T(std::int64_t(gen() % n)), l);
+
+    total += bench::time_it([&]() { l = op(pool, l); });
+    bench::do_not_optimize(l);
+  }
+  return total / reps;
+}
+
+template <typename T>
+void compare(const std::string& name, std::size_t n, std::size_t reps) {
+  auto round_trip_sort = [](auto& pool, std::uint32_t l) {
+    auto v = stack_utils::to_vector(pool, l);
+    std::stable_sort(v.begin(), v.end());
+    return stack_utils::push_all(pool, pool.end(), v.rbegin(), v.rend());
+  };
+  auto relink_sort = [](auto& pool, std::uint32_t l) {
+    return stack_utils::sort_stack(pool, l);
+  };
+  auto round_trip_reverse = [](auto& pool, std::uint32_t l) {
+    auto v = stack_utils::to_vector(pool, l);
+    return stack_utils::push_all(pool, pool.end(), v.begin(), v.end());
+  };
+  auto relink_reverse = [](auto& pool, std::uint32_t l) {
+    return stack_utils::reverse_stack(pool, l);
+  };
+
+  double t[4] = {run<T>(n, reps, round_trip_sort),
+                 run<T>(n, reps, relink_sort),
+                 run<T>(n, reps, round_trip_reverse),
+                 run<T>(n, reps, relink_reverse)};
+  const char* labels[4] = {"sort,round_trip", "sort,relink",
+                           "reverse,round_trip", "reverse,relink"};
+  for (int i = 0; i < 4; ++i)
+    std::cout << name << ',' << labels[i] << ',' << n << ','
+              << t[i] * 1e9 / n << ',' << t[i % 2 ? i - 1 : i] / t[i]
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+  const std::size_t n = bench::arg(argc, argv, 1, 200000);
+  const std::size_t reps = bench::arg(argc, argv, 2, 5);
+
+  std::cout << "value,algorithm,method,size,ns_per_value,speedup" << std::endl;
+  compare<std::int64_t>("int64", n, reps);
+  compare<item<256>>("256_bytes", n, reps);
+}
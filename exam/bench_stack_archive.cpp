@@ -0,0 +1,85 @@
+#include "bench_utils.hpp"
+#include "stack_archive.hpp"
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// size of the archive of stacks of integers (sorted, clustered or random),
+// compared with the raw values and with a dump of the nodes, and speed of
+// encoding and decoding
+
+using pool_type = stack_pool<std::int64_t, std::uint32_t>;
+
+// the values of a stack are pushed in increasing order: sorted stacks have
+// small gaps, clustered ones are scattered within a window
+std::int64_t next_value(const std::string& kind,
+                        std::int64_t previous,
+                        std::mt19937_64& gen) {
+  if (kind == "sorted")
+    return previous + std::int64_t(gen() % 16);
+  if (kind == "clustered")
+    return previous + std::int64_t(gen() % 1000) - 450;
+  return std::int64_t(gen());
+}
+
+int main(int argc, char** argv) {
+  const std::size_t n = bench::arg(argc, argv, 1, 1 << 22);
+  const std::size_t n_stacks = bench::arg(argc, argv, 2, 4096);
+  const std::size_t reps = bench::arg(argc, argv, 3, 3);
+
+  std::cout << "data,block_values,values,bytes_per_value,ratio_to_values,"
+               "ratio_to_nodes,encode_pool_gb_per_s,encode_frozen_gb_per_s,"
+               "decode_gb_per_s"
+            << std::endl;
+  for (std::string kind : {"sorted", "clustered", "random"}) {
+    pool_type pool{n};
+    std::vector<std::uint32_t> heads(n_stacks, pool.end());
+    std::vector<std::int64_t> last(n_stacks, 1 << 30);
+    std::mt19937_64 gen{42};
+    for (std::size_t i = 0; i < n; ++i) {
+      const std::size_t s = gen() % n_stacks;
+      last[s] = next_value(kind, last[s], gen);
+      heads[s] = pool.push(last[s], heads[s]);
+    }
+    // a dump of the nodes stores an index besides each value
+    const double node_bytes = double(pool.stats().bytes_used) / n;
+    const double raw = double(n * sizeof(std::int64_t));
+    const auto frozen = stack_utils::freeze(pool, heads);
+
+    for (std::size_t block_values : {16, 256}) {
+      std::string archive;
+      double encode = 0, encode_frozen = 0, decode = 0;
+      for (std::size_t r = 0; r < reps; ++r) {
+        std::ostringstream out;
+        encode += bench::time_it([&]() {
+          stack_utils::write_archive(out, pool, heads, block_values);
+        });
+        archive = out.str();
+        std::ostringstream out_frozen;
+        encode_frozen += bench::time_it([&]() {
+          stack_utils::write_archive(out_frozen, frozen, block_values);
+        });
+
+        std::istringstream in{archive};
+        pool_type decoded{n};
+        // touch the memory of the nodes first, so that the page faults are
+        // not counted
+        decoded.checkpoint();
+        decoded.allocate_block(n);
+        decoded.rollback();
+        decode += bench::time_it([&]() {
+          bench::do_not_optimize(stack_utils::read_archive(in, decoded));
+        });
+      }
+      std::cout << kind << ',' << block_values << ',' << n << ','
+                << double(archive.size()) / n << ',' << raw / archive.size()
+                << ',' << node_bytes * n / archive.size() << ','
+                << raw * reps / encode * 1e-9 << ','
+                << raw * reps / encode_frozen * 1e-9 << ','
+                << raw * reps / decode * 1e-9 << std::endl;
+    }
+  }
+}
@@ -0,0 +1,85 @@
+#include "bench_utils.hpp"
+#include "stack_ingest.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// load `stack_id<TAB>value` lines (and the same pairs as binary records)
+// into a stack_pool: with operator>> and push, and with the mmap ingestors
+// on an increasing number of threads
+
+const char* const text_path = "bench_stack_ingest.txt";
+const char* const binary_path = "bench_stack_ingest.bin";
+
+template <typename T>
+void write_files(std::size_t n, std::size_t n_stacks) {
+  std::mt19937 gen{42};
+  std::ofstream text{text_path}, binary{binary_path, std::ios::binary};
+  for (std::size_t i = 0; i < n; ++i) {
+    const std::uint32_t id = gen() % n_stacks;
+    const T value = T(gen() % 1000000) / T(8);
+    text << id << '\t' << value << '\n';
+    binary.write(reinterpret_cast<const char*>(&id), sizeof(id));
+    binary.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+}
+
+std::size_t file_size(const char* path) {
+  return mapped_file{path}.size();
+}
+
+template <typename T>
+void run(const std::string& type,
+         std::size_t n,
+         std::size_t n_stacks,
+         std::size_t max_threads) {
+  write_files<T>(n, n_stacks);
+  auto report = [&](const std::string& method, std::size_t threads,
+                    const char* path, double t) {
+    std::cout << method << ',' << type << ',' << threads << ',' << n << ','
+              << file_size(path) * 1e-6 << ',' << t << ','
+              << file_size(path) * 1e-6 / t << std::endl;
+  };
+
+  {
+    stack_pool<T, std::uint32_t> pool;
+    std::vector<std::uint32_t> heads(n_stacks, pool.end());
+    report("operator>>", 1, text_path, bench::time_it([&]() {
+             std::ifstream in{text_path};
+             std::uint32_t id;
+             T value;
+             while (in >> id >> value)
+               heads[id] = pool.push(value, heads[id]);
+           }));
+  }
+
+  for (std::size_t t = 1; t <= max_threads; t *= 2) {
+    work_stealing_pool tp{t};
+    stack_pool<T, std::uint32_t> text, binary;
+    report("ingest_text", t, text_path, bench::time_it([&]() {
+             bench::do_not_optimize(
+                 stack_utils::ingest_text(tp, text_path, text));
+           }));
+    report("ingest_binary", t, binary_path, bench::time_it([&]() {
+             bench::do_not_optimize(
+                 stack_utils::ingest_binary(tp, binary_path, binary));
+           }));
+  }
+  std::remove(text_path);
+  std::remove(binary_path);
+}
+
+int main(int argc, char** argv) {
+  const std::size_t n = bench::arg(argc, argv, 1, 1 << 21);
+  const std::size_t n_stacks = bench::arg(argc, argv, 2, 10000);
+  const std::size_t max_threads = bench::arg(argc, argv, 3, 8);
+
+  std::cout << "method,type,threads,pairs,megabytes,seconds,mb_per_s"
+            << std::endl;
+  run<std::int64_t>("int64", n, n_stacks, max_threads);
+  run<double>("double", n, n_stacks, max_threads);
+}
@@ -0,0 +1,111 @@
+#include "bench_utils.hpp"
+#include "stack_journal.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// throughput of pushes and pops on pools recorded in a journal, at several
+// durability levels, compared with the journal-free pool. Each thread has its
+// own pool (and stream); the time includes the last commit, after which every
+// operation is durable
+
+const std::string path = "bench_stack_journal.tmp";
+
+struct level {
+  std::string name;
+  bool journal;
+  journal_options options;
+  // commit after each operation
+  bool commit_each;
+};
+
+// push mostly, and sometimes pop, on `n_slots` stacks
+template <typename F>
+void run_ops(std::size_t n_ops, std::size_t n_slots, unsigned seed, F op) {
+  std::mt19937 gen{seed};
+  for (std::size_t i = 0; i < n_ops; ++i) {
+    const std::uint32_t r = gen();
+    op(r % n_slots, r % 4 == 0, std::int64_t(i));
+  }
+}
+
+int main(int argc, char** argv) {
+  const std::size_t n = bench::arg(argc, argv, 1, 1 << 20);
+  // operations with a commit (and fsync) each
+  const std::size_t n_synced = bench::arg(argc, argv, 2, 1000);
+  const std::size_t n_slots = bench::arg(argc, argv, 3, 1024);
+  using us = std::chrono::microseconds;
+
+  const std::vector<level> levels = {
+      {"no_journal", false, {}, false},
+      {"no_sync", true, {us{1000}, false}, false},
+      {"sync_every_10ms", true, {us{10000}, true}, false},
+      {"sync_every_1ms", true, {us{1000}, true}, false},
+      {"sync_each_op", true, {us{0}, true}, true},
+  };
+
+  std::cout << "level,threads,ops,seconds,mops_per_s,commits,journal_mb"
+            << std::endl;
+  for (const level& l : levels) {
+    for (std::size_t n_threads : {1, 4}) {
+      std::remove(path.c_str());
+      const std::size_t ops = l.commit_each ? n_synced : n;
+      const std::size_t per_thread = ops / n_threads;
+      std::uint64_t commits = 0;
+      double t = 0;
+      if (!l.journal) {
+        t = bench::time_it([&]() {
+          std::vector<std::thread> threads;
+          for (std::size_t k = 0; k < n_threads; ++k)
+            threads.emplace_back([&, k]() {
+              stack_pool<std::int64_t, std::uint32_t> pool;
+              std::vector<std::uint32_t> heads(n_slots, pool.end());
+              run_ops(per_thread, n_slots, unsigned(k),
+                      [&](std::size_t s, bool pop, std::int64_t v) {
+                        if (pop && !pool.empty(heads[s]))
+                          heads[s] = pool.pop(heads[s]);
+                        else
+                          heads[s] = pool.push(v, heads[s]);
+                      });
+              bench::do_not_optimize(heads);
+            });
+          for (auto& th : threads)
+            th.join();
+        });
+      } else {
+        stack_journal j{path, l.options};
+        t = bench::time_it([&]() {
+          std::vector<std::thread> threads;
+          for (std::size_t k = 0; k < n_threads; ++k)
+            threads.emplace_back([&, k]() {
+              journaled_stack_pool<std::int64_t, std::uint32_t> pool{
+                  j, std::uint32_t(k)};
+              run_ops(per_thread, n_slots, unsigned(k),
+                      [&](std::size_t s, bool pop, std::int64_t v) {
+                        if (pop && !pool.underlying().empty(pool.head(s)))
+                          pool.pop(s);
+                        else
+                          pool.push(s, v);
+                        if (l.commit_each)
+                          j.commit();
+                      });
+            });
+          for (auto& th : threads)
+            th.join();
+          j.commit();
+        });
+        commits = j.commits();
+      }
+      std::ifstream in{path, std::ios::binary | std::ios::ate};
+      const double mb = in ? double(in.tellg()) / (1 << 20) : 0;
+      std::cout << l.name << ',' << n_threads << ',' << ops << ',' << t << ','
+                << ops / t * 1e-6 << ',' << commits << ',' << mb << std::endl;
+    }
+  }
+  std::remove(path.c_str());
+}
@@ -0,0 +1,106 @@
+#include "bench_utils.hpp"
+#include "stack_trace.hpp"
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// replay of a recorded workload on several configurations of stack_pool:
+// the trace is read from the file given as first argument, or recorded from
+// a synthetic workload (random pushes, pops and free_stack on many stacks)
+
+// the synthetic workload, applied to a pool which may record it
+template <typename Pool>
+void workload(Pool& pool, std::size_t n, std::size_t n_stacks) {
+  std::mt19937 gen{42};
+  std::vector<std::uint32_t> heads(n_stacks, pool.end());
+  for (std::size_t i = 0; i < n; ++i) {
+    auto& h = heads[gen() % n_stacks];
+    const auto r = gen() % 100;
+    if (r < 60 || pool.empty(h))
+      h = pool.push(std::string(r % 32, 'x'), h);
+    else if (r < 99)
+      h = pool.pop(h);
+    else
+      h = pool.free_stack(h);
+  }
+}
+
+template <typename Pool, typename MakeValue>
+void run(const std::string& config,
+         const std::vector<trace_record>& records,
+         std::size_t reserve,
+         MakeValue make_value,
+         std::size_t reps) {
+  std::vector<double> latencies;
+  double t = 0;
+  for (std::size_t r = 0; r < reps; ++r) {
+    {
+      Pool pool;
+      pool.reserve(reserve);
+      t += bench::time_it([&]() {
+        bench::do_not_optimize(stack_utils::replay(records, pool, make_value));
+      });
+    }
+    Pool pool;
+    pool.reserve(reserve);
+    stack_utils::replay(records, pool, make_value, &latencies);
+  }
+  std::cout << config << ',' << records.size() << ','
+            << records.size() * reps / t * 1e-6 << ','
+            << bench::percentile(latencies, 0.5) << ','
+            << bench::percentile(latencies, 0.99) << ','
+            << bench::percentile(latencies, 0.999) << std::endl;
+}
+
+int main(int argc, char** argv) {
+  const std::size_t n = bench::arg(argc, argv, 2, 1000000);
+  const std::size_t reps = bench::arg(argc, argv, 3, 5);
+  const std::size_t n_stacks = 4096;
+
+  std::vector<trace_record> records;
+  if (argc > 1 && std::string(argv[1]) != "-") {
+    std::ifstream in{argv[1], std::ios::binary};
+    records = trace_buffer::read(in);
+  } else {
+    using pool_type = recording_stack_pool<std::string, std::uint32_t>;
+    // the overhead of recording
+    double t_plain = 0, t_recording = 0;
+    for (std::size_t r = 0; r < reps; ++r) {
+      trace_buffer trace{n};
+      pool_type plain, recording;
+      recording.record_to(&trace);
+      t_plain += bench::time_it([&]() { workload(plain, n, n_stacks); });
+      t_recording +=
+          bench::time_it([&]() { workload(recording, n, n_stacks); });
+      if (r == 0)
+        records = trace.records();
+    }
+    std::cerr << "recording overhead: "
+              << (t_recording / t_plain - 1) * 100 << '%' << std::endl;
+  }
+
+  // the largest head of the trace bounds the number of nodes
+  std::size_t nodes = 0;
+  for (const auto& r : records)
+    nodes = std::max<std::size_t>(nodes, std::max(r.head, r.result));
+
+  auto make_int = [](std::uint32_t size) { return std::int64_t(size); };
+  auto make_string = [](std::uint32_t size) { return std::string(size, 'y'); };
+
+  std::cout << "config,records,mops_per_s,p50_ns,p99_ns,p999_ns" << std::endl;
+  run<stack_pool<std::int64_t, std::uint32_t>>("int64/uint32", records, 0,
+                                               make_int, reps);
+  run<stack_pool<std::int64_t, std::uint32_t>>("int64/uint32/reserve",
+                                               records, nodes, make_int, reps);
+  run<stack_pool<std::int64_t, std::uint64_t>>("int64/uint64", records, 0,
+                                               make_int, reps);
+  run<stack_pool<std::int64_t, std::uint64_t>>("int64/uint64/reserve",
+                                               records, nodes, make_int, reps);
+  run<stack_pool<std::string, std::uint32_t>>("string/uint32", records, 0,
+                                              make_string, reps);
+  run<stack_pool<std::string, std::uint32_t>>(
+      "string/uint32/reserve", records, nodes, make_string, reps);
+}
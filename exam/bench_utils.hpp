@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+// small helpers shared by the bench_*.cpp executables, which print their
+// results as CSV on the standard output
+namespace bench {
+  using clock = std::chrono::steady_clock;
+
+  inline double seconds_since(clock::time_point t0) {
+    return std::chrono::duration<double>(clock::now() - t0).count();
+  }
+
+  /**
+   * @brief Return the time (in seconds) needed to call `f()`.
+   */
+  template <typename F>
+  double time_it(F&& f) {
+    auto t0 = clock::now();
+    f();
+    return seconds_since(t0);
+  }
+
+  /**
+   * @brief Return the `p`-th percentile (`0 <= p <= 1`) of the given
+   * samples. The samples are reordered.
+   */
+  template <typename X>
+  X percentile(std::vector<X>& samples, double p) {
+    if (samples.empty())
+      return X{};
+    auto nth = samples.begin() +
+               static_cast<std::ptrdiff_t>(p * (samples.size() - 1));
+    std::nth_element(samples.begin(), nth, samples.end());
+    return *nth;
+  }
+
+  /**
+   * @brief Read the `i`-th command line argument as an unsigned number, or
+   * return `fallback` if it was not given.
+   */
+  inline std::size_t arg(int argc, char** argv, int i, std::size_t fallback) {
+    return argc > i ? std::strtoull(argv[i], nullptr, 10) : fallback;
+  }
+
+  // prevent the compiler from optimizing away the computation of `x`
+  template <typename X>
+  void do_not_optimize(const X& x) {
+    asm volatile("" : : "r,m"(x) : "memory");
+  }
+}  // namespace bench
@@ -0,0 +1,393 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "concurrent_queue needs lock-free 64-bit atomics");
+
+/**
+ * @brief A pool of nodes which can be shared among multiple threads.
+ *
+ * This is the concurrent sibling of stack_pool: nodes are "addressed" using
+ * `1+idx`, where `idx` is the position of the node in the pool, so that `0`
+ * can be used as `end`. Released nodes are kept in a stack of free nodes and
+ * recycled by later allocations, therefore no memory is requested to the
+ * system once the pool has reached its working size.
+ *
+ * Differently from stack_pool, nodes never move: the storage is a sequence
+ * of chunks whose size doubles each time the pool grows, and the address of
+ * a node is mapped to the right chunk with some bit arithmetic. This is
+ * needed since other threads may be reading a node while the pool grows.
+ *
+ * The stack of free nodes is a lock-free (Treiber) stack. Its head is a
+ * tagged index: the lower 32 bits hold the address of the node, the upper
+ * 32 bits a counter which is incremented at each modification to rule out
+ * the ABA problem.
+ *
+ * If the pool is bounded, all the nodes are allocated by the constructor and
+ * allocate() returns end() when there is no free node. Otherwise a new chunk
+ * is allocated (holding a mutex) when needed.
+ *
+ * @tparam T Type of the values held in the nodes.
+ */
+template <typename T>
+class concurrent_node_pool {
+ public:
+  using stack_type = std::uint32_t;
+  using tagged_type = std::uint64_t;
+  using size_type = std::size_t;
+
+  struct node_t {
+    T value;
+    std::atomic<tagged_type> next;
+  };
+
+  static constexpr stack_type address(tagged_type x) noexcept {
+    return static_cast<stack_type>(x);
+  }
+  static constexpr std::uint32_t tag(tagged_type x) noexcept {
+    return static_cast<std::uint32_t>(x >> 32);
+  }
+  // build a tagged index which follows `previous`
+  static constexpr tagged_type tagged(stack_type x,
+                                      tagged_type previous) noexcept {
+    return (tagged_type(tag(previous) + 1) << 32) | x;
+  }
+
+ private:
+  static constexpr size_type max_chunks = 32;
+
+  size_type first_chunk_log;
+  bool bounded;
+
+  std::atomic<node_t*> chunks[max_chunks];
+  // number of nodes which may be handed out by allocate()
+  std::atomic<size_type> capacity_;
+  // number of nodes which were handed out at least once
+  std::atomic<size_type> used;
+  std::atomic<tagged_type> free_nodes;
+
+  std::mutex growth_mutex;
+
+  size_type chunk_size(size_type k) const noexcept {
+    return size_type(1) << (first_chunk_log + k);
+  }
+
+  // the chunk k starts at (2^k - 1) * first_chunk_size
+  static size_type chunk_of(size_type q) noexcept {
+    return 63 - __builtin_clzll(q);
+  }
+
+  void grow(size_type observed_capacity) {
+    std::lock_guard<std::mutex> lock{growth_mutex};
+    // someone else already did it
+    if (capacity_.load(std::memory_order_acquire) != observed_capacity)
+      return;
+
+    size_type k = chunk_of((observed_capacity >> first_chunk_log) + 1);
+    if (k == max_chunks || observed_capacity + chunk_size(k) >
+                               std::numeric_limits<stack_type>::max())
+      throw std::bad_alloc();
+
+    chunks[k].store(new node_t[chunk_size(k)], std::memory_order_release);
+    capacity_.store(observed_capacity + chunk_size(k),
+                    std::memory_order_release);
+  }
+
+ public:
+  /**
+   * @brief Construct a new pool.
+   *
+   * @param n Number of nodes allocated right away. In a bounded pool this is
+   *            also the maximum number of nodes which can be allocated at the
+   *            same time.
+   * @param is_bounded Whether the pool is allowed to grow.
+   *
+   * This throws std::length_error if the first chunk, of `n` nodes (rounded
+   * up to a power of 2 if the pool is unbounded), is not addressable by
+   * stack_type.
+   */
+  concurrent_node_pool(size_type n, bool is_bounded)
+      : first_chunk_log{0},
+        bounded{is_bounded},
+        capacity_{0},
+        used{0},
+        free_nodes{0} {
+    // checked before the rounding, which could overflow the shift
+    const size_type max_nodes = std::numeric_limits<stack_type>::max();
+    if (n > (is_bounded ? max_nodes : max_nodes / 2 + 1))
+      throw std::length_error("Too many nodes for a concurrent_node_pool.");
+
+    while (!is_bounded && (size_type(1) << first_chunk_log) < n)
+      ++first_chunk_log;
+
+    for (auto& c : chunks)
+      c.store(nullptr, std::memory_order_relaxed);
+
+    // a bounded pool is made of a single chunk of exactly n nodes
+    size_type first = is_bounded ? n : chunk_size(0);
+    if (first != 0) {
+      chunks[0].store(new node_t[first], std::memory_order_relaxed);
+      capacity_.store(first, std::memory_order_relaxed);
+    }
+  }
+
+  concurrent_node_pool(const concurrent_node_pool&) = delete;
+  concurrent_node_pool& operator=(const concurrent_node_pool&) = delete;
+
+  ~concurrent_node_pool() noexcept {
+    for (auto& c : chunks)
+      delete[] c.load(std::memory_order_relaxed);
+  }
+
+  stack_type end() const noexcept { return stack_type(0); }
+
+  /**
+   * @brief Return the node having the given address. The address must have
+   * been returned by allocate().
+   *
+   * @param x
+   * @return node_t&
+   */
+  node_t& node(stack_type x) noexcept {
+    size_type idx = x - 1;
+    if (bounded)
+      return chunks[0].load(std::memory_order_relaxed)[idx];
+
+    size_type k = chunk_of((idx >> first_chunk_log) + 1);
+    size_type offset = idx - (chunk_size(0) * ((size_type(1) << k) - 1));
+    return chunks[k].load(std::memory_order_acquire)[offset];
+  }
+
+  /**
+   * @brief Take a node from the pool. The new node is taken from the stack
+   * of free nodes if possible.
+   *
+   * This method throws std::bad_alloc if an unbounded pool cannot grow
+   * anymore.
+   *
+   * @return stack_type The address of the node, or end() if the pool is
+   *            bounded and exhausted.
+   */
+  stack_type allocate() {
+    tagged_type head = free_nodes.load(std::memory_order_acquire);
+    while (address(head) != end()) {
+      // if the node was taken meanwhile this reads garbage, but the CAS fails
+      tagged_type next =
+          node(address(head)).next.load(std::memory_order_relaxed);
+      if (free_nodes.compare_exchange_weak(head, tagged(address(next), head),
+                                           std::memory_order_acquire))
+        return address(head);
+    }
+
+    // no free node, we use a node which was never handed out
+    size_type n = used.load(std::memory_order_relaxed);
+    while (true) {
+      size_type cap = capacity_.load(std::memory_order_acquire);
+      if (n < cap) {
+        if (used.compare_exchange_weak(n, n + 1, std::memory_order_relaxed))
+          return static_cast<stack_type>(n + 1);
+      } else if (bounded) {
+        // nodes may have been released while we were trying
+        return address(free_nodes.load(std::memory_order_relaxed)) == end()
+                   ? end()
+                   : allocate();
+      } else {
+        grow(cap);
+      }
+    }
+  }
+
+  /**
+   * @brief Give a node back to the pool, i.e. push it onto the stack of free
+   * nodes.
+   *
+   * @param x Address of the node.
+   */
+  void release(stack_type x) noexcept {
+    node_t& n = node(x);
+    tagged_type head = free_nodes.load(std::memory_order_relaxed);
+    do {
+      tagged_type previous = n.next.load(std::memory_order_relaxed);
+      n.next.store(tagged(address(head), previous), std::memory_order_relaxed);
+    } while (!free_nodes.compare_exchange_weak(head, tagged(x, head),
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed));
+  }
+
+  /**
+   * @brief Return the number of nodes the pool may hand out without growing.
+   *
+   * @return size_type
+   */
+  size_type capacity() const noexcept {
+    return capacity_.load(std::memory_order_relaxed);
+  }
+};
+
+/**
+ * @brief A multi-producer multi-consumer FIFO queue.
+ *
+ * This is the lock-free queue by Michael and Scott, using tagged indices
+ * instead of tagged pointers. Nodes are taken from a concurrent_node_pool and
+ * given back to it when they are popped, so that steady-state usage does not
+ * allocate.
+ *
+ * When popping, the value is copied out of a node which may be recycled
+ * concurrently by another thread: the copy is discarded when this happens,
+ * but for this reason T must be trivially copyable (like
+ * `boost::lockfree::queue`).
+ *
+ * @tparam T Type of the values held in the queue.
+ * @tparam Bounded Whether the number of values in the queue is limited.
+ */
+template <typename T, bool Bounded>
+class basic_mpmc_queue {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "mpmc_queue values must be trivially copyable");
+
+  using node_pool = concurrent_node_pool<T>;
+  using stack_type = typename node_pool::stack_type;
+  using tagged_type = typename node_pool::tagged_type;
+
+  node_pool pool;
+
+  // head and tail live on different cache lines, since they are modified by
+  // consumers and producers respectively
+  alignas(64) std::atomic<tagged_type> head;
+  alignas(64) std::atomic<tagged_type> tail;
+
+  static constexpr stack_type address(tagged_type x) noexcept {
+    return node_pool::address(x);
+  }
+  static constexpr tagged_type tagged(stack_type x,
+                                      tagged_type previous) noexcept {
+    return node_pool::tagged(x, previous);
+  }
+
+ public:
+  using value_type = T;
+  using size_type = typename node_pool::size_type;
+
+  /**
+   * @brief Construct a new queue.
+   *
+   * @param n The capacity of a bounded queue, or the number of nodes
+   *            allocated right away by an unbounded queue.
+   */
+  explicit basic_mpmc_queue(size_type n = 1024)
+      // one more node is needed for the dummy node at the front
+      : pool{n + 1, Bounded} {
+    stack_type dummy = pool.allocate();
+    pool.node(dummy).next.store(pool.end(), std::memory_order_relaxed);
+    head.store(dummy, std::memory_order_relaxed);
+    tail.store(dummy, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Append a value at the back of the queue.
+   *
+   * This method throws std::bad_alloc if an unbounded queue cannot grow
+   * anymore.
+   *
+   * @param val The value to be appended.
+   * @return true If the value was appended.
+   * @return false If the queue is bounded and full.
+   */
+  bool push(const T& val) {
+    stack_type x = pool.allocate();
+    if (x == pool.end())
+      return false;
+
+    auto& n = pool.node(x);
+    n.value = val;
+    n.next.store(tagged(pool.end(), n.next.load(std::memory_order_relaxed)),
+                 std::memory_order_relaxed);
+
+    tagged_type t;
+    while (true) {
+      t = tail.load(std::memory_order_acquire);
+      auto& last = pool.node(address(t));
+      tagged_type next = last.next.load(std::memory_order_acquire);
+      if (t != tail.load(std::memory_order_acquire))
+        continue;
+
+      if (address(next) == pool.end()) {
+        if (last.next.compare_exchange_weak(next, tagged(x, next),
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed))
+          break;
+      } else {
+        // the tail is lagging behind, help the other producer
+        tail.compare_exchange_weak(t, tagged(address(next), t),
+                                   std::memory_order_release,
+                                   std::memory_order_relaxed);
+      }
+    }
+    tail.compare_exchange_strong(t, tagged(x, t), std::memory_order_release,
+                                 std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * @brief Remove the value at the front of the queue.
+   *
+   * @param val Where the value is stored.
+   * @return true If a value was popped.
+   * @return false If the queue was empty.
+   */
+  bool pop(T& val) noexcept {
+    tagged_type h;
+    while (true) {
+      h = head.load(std::memory_order_acquire);
+      tagged_type t = tail.load(std::memory_order_acquire);
+      tagged_type next =
+          pool.node(address(h)).next.load(std::memory_order_acquire);
+      if (h != head.load(std::memory_order_acquire))
+        continue;
+
+      if (address(h) == address(t)) {
+        if (address(next) == pool.end())
+          return false;
+        tail.compare_exchange_weak(t, tagged(address(next), t),
+                                   std::memory_order_release,
+                                   std::memory_order_relaxed);
+      } else {
+        // the next node becomes the new dummy node
+        T tmp = pool.node(address(next)).value;
+        if (head.compare_exchange_weak(h, tagged(address(next), h),
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+          val = tmp;
+          break;
+        }
+      }
+    }
+    pool.release(address(h));
+    return true;
+  }
+
+  /**
+   * @brief Check whether the queue is empty. The result may be outdated as
+   * soon as it is returned if other threads are using the queue.
+   *
+   * @return true If the queue is empty.
+   * @return false Otherwise.
+   */
+  bool empty() const noexcept {
+    return address(head.load(std::memory_order_acquire)) ==
+           address(tail.load(std::memory_order_acquire));
+  }
+};
+
+template <typename T>
+using mpmc_queue = basic_mpmc_queue<T, false>;
+
+template <typename T>
+using bounded_mpmc_queue = basic_mpmc_queue<T, true>;
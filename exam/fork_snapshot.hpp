@@ -0,0 +1,349 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * @brief Statistics of a snapshot taken by fork_snapshot.
+ */
+struct fork_snapshot_stats {
+  // time spent by the parent in fork(), i.e. copying the page tables
+  double pause_seconds;
+  // time spent by the child to write and sync the snapshot
+  double seconds;
+  std::uint64_t bytes;
+  // memory duplicated because the parent wrote to pages shared with the
+  // child, from the private memory of the child (0 if
+  // /proc/self/smaps_rollup is not available)
+  std::uint64_t cow_bytes;
+};
+
+namespace stack_utils {
+  namespace detail {
+    /**
+     * @brief An output stream buffer writing to a file descriptor, which
+     * does not allocate. Large writes bypass the buffer.
+     */
+    class fd_streambuf : public std::streambuf {
+      int fd;
+      char buffer[1 << 16];
+      std::uint64_t written;
+
+      bool write_all(const char* p, std::size_t n) noexcept {
+        while (n > 0) {
+          const ssize_t w = ::write(fd, p, n);
+          if (w < 0) {
+            if (errno == EINTR)
+              continue;
+            error = errno;
+            return false;
+          }
+          p += w;
+          n -= std::size_t(w);
+          written += std::uint64_t(w);
+        }
+        return true;
+      }
+
+      bool flush_buffer() noexcept {
+        const std::size_t n = std::size_t(pptr() - pbase());
+        setp(buffer, buffer + sizeof(buffer));
+        return write_all(buffer, n);
+      }
+
+     protected:
+      int_type overflow(int_type c) override {
+        if (!flush_buffer())
+          return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+          sputc(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+      }
+
+      std::streamsize xsputn(const char* s, std::streamsize n) override {
+        if (n < epptr() - pptr()) {
+          std::memcpy(pptr(), s, std::size_t(n));
+          pbump(int(n));
+          return n;
+        }
+        return flush_buffer() && write_all(s, std::size_t(n)) ? n : 0;
+      }
+
+      int sync() override { return flush_buffer() ? 0 : -1; }
+
+     public:
+      // errno of the write which failed, or 0
+      int error;
+
+      explicit fd_streambuf(int f) noexcept : fd{f}, written{0}, error{0} {
+        setp(buffer, buffer + sizeof(buffer));
+      }
+
+      std::uint64_t bytes() const noexcept { return written; }
+    };
+
+    /**
+     * @brief Return the private memory (in bytes) of this process, or 0 if
+     * it cannot be read. This does not allocate.
+     */
+    inline std::uint64_t private_bytes() noexcept {
+      const int fd = ::open("/proc/self/smaps_rollup", O_RDONLY);
+      if (fd < 0)
+        return 0;
+      char text[4096];
+      std::size_t n = 0;
+      ssize_t r;
+      while (n < sizeof(text) - 1 &&
+             (r = ::read(fd, text + n, sizeof(text) - 1 - n)) > 0)
+        n += std::size_t(r);
+      ::close(fd);
+      text[n] = '\0';
+
+      std::uint64_t kb = 0;
+      for (const char* key : {"Private_Clean:", "Private_Dirty:"}) {
+        const char* p = std::strstr(text, key);
+        if (p)
+          kb += std::strtoull(p + std::strlen(key), nullptr, 10);
+      }
+      return kb * 1024;
+    }
+
+    // sent by the child to the parent through a pipe
+    struct fork_snapshot_report {
+      double seconds;
+      std::uint64_t bytes;
+      std::uint64_t cow_bytes;
+      // errno of a system call which failed, or 0
+      int error;
+      // the message of an exception thrown by the writer, or of the error
+      char message[256];
+    };
+  }  // namespace detail
+}  // namespace stack_utils
+
+/**
+ * @brief A snapshot written in the background by a child process, while the
+ * parent keeps running (and modifying the data), as Redis does.
+ *
+ * The constructor forks the process and returns. The child sees the memory of
+ * the parent at the moment of the fork, which the kernel shares until one of
+ * them writes a page: then the page is copied (copy on write). The parent is
+ * paused only by fork(), which copies the page tables (about 2 MB per GB of
+ * memory, unless huge pages are used). The child writes the snapshot to
+ * `path + ".tmp"`, syncs it, and renames it to `path`, so that `path` always
+ * holds a complete snapshot. The temporary file is removed on errors.
+ *
+ * Only the thread calling the constructor exists in the child, therefore the
+ * writer must not use other threads, nor locks which they may hold: writing
+ * the memory of the parent, e.g. with stack_pool::save, is fine. The memory
+ * needed by the snapshot is at most twice the memory of the parent, if the
+ * parent writes to every page before the child is done.
+ *
+ * Example:
+ *
+ *     fork_snapshot s{"pool.bin", [&pool](std::ostream& os) {
+ *       pool.save(os);
+ *     }};
+ *     // ... keep modifying pool ...
+ *     fork_snapshot_stats stats = s.wait();
+ */
+class fork_snapshot {
+  pid_t pid;
+  int report_fd;
+  double pause;
+  bool finished;
+  stack_utils::detail::fork_snapshot_report report;
+
+  // run in the child: write the snapshot, and send the report
+  template <typename F>
+  [[noreturn]] static void run_child(const char* path,
+                                     const char* tmp_path,
+                                     F& write,
+                                     int fd) noexcept {
+    using namespace stack_utils::detail;
+    fork_snapshot_report r{};
+    const auto t0 = std::chrono::steady_clock::now();
+    const std::uint64_t private_before = private_bytes();
+    auto fail = [&r](const char* what) {
+      r.error = errno;
+      std::snprintf(r.message, sizeof(r.message), "%s", what);
+    };
+
+    const int out = ::open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+      fail(tmp_path);
+    } else {
+      fd_streambuf buffer{out};
+      try {
+        std::ostream os{&buffer};
+        write(os);
+        os.flush();
+        if (!os && r.message[0] == '\0') {
+          errno = buffer.error ? buffer.error : EIO;
+          fail(tmp_path);
+        }
+      } catch (const std::exception& e) {
+        std::snprintf(r.message, sizeof(r.message), "%s", e.what());
+      } catch (...) {
+        std::snprintf(r.message, sizeof(r.message), "unknown exception");
+      }
+      r.bytes = buffer.bytes();
+      if (r.message[0] == '\0' && ::fsync(out) != 0)
+        fail(tmp_path);
+      ::close(out);
+      if (r.message[0] == '\0' && ::rename(tmp_path, path) != 0)
+        fail(path);
+      if (r.message[0] != '\0')
+        ::unlink(tmp_path);
+    }
+
+    const std::uint64_t private_after = private_bytes();
+    r.cow_bytes =
+        private_after > private_before ? private_after - private_before : 0;
+    r.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - t0)
+                    .count();
+    const char* p = reinterpret_cast<const char*>(&r);
+    std::size_t n = sizeof(r);
+    while (n > 0) {
+      const ssize_t w = ::write(fd, p, n);
+      if (w < 0 && errno == EINTR)
+        continue;
+      if (w <= 0)
+        break;
+      p += w;
+      n -= std::size_t(w);
+    }
+    // skip the destructors and the atexit handlers of the parent
+    ::_exit(0);
+  }
+
+  // read the report, once the child has exited
+  void collect(int status) {
+    finished = true;
+    std::size_t n = 0;
+    char* p = reinterpret_cast<char*>(&report);
+    ssize_t r;
+    while (n < sizeof(report) &&
+           ((r = ::read(report_fd, p + n, sizeof(report) - n)) > 0 ||
+            (r < 0 && errno == EINTR)))
+      n += r > 0 ? std::size_t(r) : 0;
+    ::close(report_fd);
+    if (n != sizeof(report) || !WIFEXITED(status)) {
+      report = {};
+      std::snprintf(report.message, sizeof(report.message),
+                    "The snapshot process died.");
+    }
+  }
+
+ public:
+  /**
+   * @brief Fork a child process writing the snapshot to `path` with
+   * `write(os)`, where `os` is a std::ostream.
+   *
+   * This throws std::system_error if the process cannot be forked.
+   *
+   * @tparam F A callable object taking a `std::ostream&`.
+   * @param path
+   * @param write
+   */
+  template <typename F>
+  fork_snapshot(const std::string& path, F write)
+      : pid{-1}, report_fd{-1}, pause{0}, finished{false}, report{} {
+    // made before the fork, since the child should not allocate
+    const std::string tmp_path = path + ".tmp";
+    int fds[2];
+    if (::pipe(fds) != 0)
+      throw std::system_error(errno, std::generic_category(), "pipe");
+
+    const auto t0 = std::chrono::steady_clock::now();
+    pid = ::fork();
+    const int e = errno;
+    if (pid == 0) {
+      ::close(fds[0]);
+      run_child(path.c_str(), tmp_path.c_str(), write, fds[1]);
+    }
+    pause = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          t0)
+                .count();
+    ::close(fds[1]);
+    if (pid < 0) {
+      ::close(fds[0]);
+      throw std::system_error(e, std::generic_category(), "fork");
+    }
+    report_fd = fds[0];
+  }
+
+  fork_snapshot(const fork_snapshot&) = delete;
+  fork_snapshot& operator=(const fork_snapshot&) = delete;
+
+  /**
+   * @brief Wait for the child, ignoring its errors.
+   */
+  ~fork_snapshot() {
+    try {
+      wait();
+    } catch (...) {
+    }
+  }
+
+  /**
+   * @brief Return whether the child is done, without waiting.
+   */
+  bool done() {
+    if (!finished) {
+      int status;
+      if (::waitpid(pid, &status, WNOHANG) == pid)
+        collect(status);
+    }
+    return finished;
+  }
+
+  /**
+   * @brief Wait for the child to be done, and return the statistics of the
+   * snapshot.
+   *
+   * This throws std::system_error if a system call of the child failed (the
+   * previous snapshot, if any, is still in `path`), and std::runtime_error if
+   * the writer threw an exception, or the child died.
+   *
+   * @return fork_snapshot_stats
+   */
+  fork_snapshot_stats wait() {
+    while (!finished) {
+      int status;
+      const pid_t r = ::waitpid(pid, &status, 0);
+      if (r == pid)
+        collect(status);
+      else if (r < 0 && errno != EINTR)
+        throw std::system_error(errno, std::generic_category(), "waitpid");
+    }
+    if (report.error != 0)
+      throw std::system_error(report.error, std::generic_category(),
+                              report.message);
+    if (report.message[0] != '\0')
+      throw std::runtime_error(report.message);
+    return fork_snapshot_stats{pause, report.seconds, report.bytes,
+                               report.cow_bytes};
+  }
+
+  /**
+   * @brief Return the time spent by the parent in fork().
+   */
+  double pause_seconds() const noexcept { return pause; }
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "batched_traversal.hpp"
+#include "stack_pool.hpp"
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Read-only stacks stored in compressed sparse row format: the values
+ * of all the stacks in one array, stack after stack and each one from top to
+ * bottom, and the offset of each stack in that array.
+ *
+ * Stack `i` is the contiguous range `[begin(i), end(i))`, which can be given
+ * to the algorithms in `<algorithm>` and `<numeric>` and vectorized by the
+ * compiler, unlike a traversal of a stack_pool which follows a chain of
+ * dependent loads. Use stack_utils::freeze to build it from a pool, and
+ * stack_utils::thaw to go back to a pool.
+ *
+ * @tparam T Type of the values.
+ */
+template <typename T>
+class frozen_stacks {
+  std::vector<T> vals;
+  // offs[i] is the position of the top of stack i, offs.back() the number
+  // of values
+  std::vector<std::size_t> offs;
+
+ public:
+  using size_type = std::size_t;
+
+  /**
+   * @brief Construct an object holding no stacks.
+   */
+  frozen_stacks() : offs{0} {}
+
+  /**
+   * @brief Construct the stacks from their values and offsets.
+   *
+   * This throws std::invalid_argument if `offsets` does not start with 0, is
+   * decreasing somewhere, or does not end with the number of values.
+   *
+   * @param values The values of the stacks, one stack after the other.
+   * @param offsets The position of the top of each stack in `values`,
+   *            followed by the number of values.
+   */
+  frozen_stacks(std::vector<T> values, std::vector<std::size_t> offsets)
+      : vals{std::move(values)}, offs{std::move(offsets)} {
+    if (offs.empty() || offs.front() != 0 || offs.back() != vals.size())
+      throw std::invalid_argument("Invalid offsets.");
+    for (size_type i = 1; i < offs.size(); ++i)
+      if (offs[i - 1] > offs[i])
+        throw std::invalid_argument("Invalid offsets.");
+  }
+
+  /**
+   * @brief Return the number of stacks.
+   */
+  size_type size() const noexcept { return offs.size() - 1; }
+
+  /**
+   * @brief Return the number of values in stack `i`.
+   */
+  size_type length(size_type i) const { return offs.at(i + 1) - offs[i]; }
+
+  /**
+   * @brief Return a pointer to the top of stack `i`. The other values of
+   * the stack follow it, up to end(i).
+   */
+  const T* begin(size_type i) const { return end(i) - length(i); }
+  const T* end(size_type i) const { return vals.data() + offs.at(i + 1); }
+
+  const std::vector<T>& values() const noexcept { return vals; }
+  const std::vector<std::size_t>& offsets() const noexcept { return offs; }
+};
+
+namespace stack_utils {
+  /**
+   * @brief Copy the given stacks into a frozen_stacks, where stack `i` is
+   * `heads[i]`. The pool is not modified.
+   *
+   * The stacks are visited twice, to measure them and to copy them, walking
+   * many of them at the same time (see batched_walk). Stacks which share
+   * their tail are copied entirely.
+   *
+   * This function throws an exception if some head is not a valid index in
+   * the pool.
+   *
+   * @tparam value_type Type of the values held in the stack pool.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @param pool Stack pool containing the stacks.
+   * @param heads Heads of the stacks to be frozen.
+   * @return frozen_stacks<value_type>
+   */
+  template <typename value_type, typename stack_type>
+  frozen_stacks<value_type> freeze(
+      const stack_pool<value_type, stack_type>& pool,
+      const std::vector<stack_type>& heads) {
+    std::vector<std::size_t> offsets = batched_stack_sizes(pool, heads);
+    std::size_t total = 0;
+    for (auto& o : offsets) {
+      const std::size_t length = o;
+      o = total;
+      total += length;
+    }
+
+    // offsets[i] is used as the cursor of stack i, then restored
+    std::vector<value_type> values(total);
+    batched_for_each(pool, heads, [&](std::size_t i, const value_type& x) {
+      values[offsets[i]++] = x;
+    });
+    for (std::size_t i = offsets.size(); i-- > 1;)
+      offsets[i] = offsets[i - 1];
+    if (!offsets.empty())
+      offsets[0] = 0;
+    offsets.push_back(total);
+    return frozen_stacks<value_type>{std::move(values), std::move(offsets)};
+  }
+
+  /**
+   * @brief Copy the given frozen stacks into a new pool, and return it with
+   * the head of stack `i` at index `i`.
+   *
+   * The nodes of each stack are contiguous, from the top to the bottom (see
+   * stack_pool::allocate_block), therefore the first traversals of the pool
+   * are as fast as possible.
+   *
+   * This function throws std::length_error if the nodes are not addressable
+   * by N.
+   *
+   * @tparam N Type of "pointers" to stack nodes.
+   * @tparam T Type of the values.
+   * @param frozen
+   * @return std::pair<stack_pool<T, N>, std::vector<N>>
+   */
+  template <typename N, typename T>
+  std::pair<stack_pool<T, N>, std::vector<N>> thaw(
+      const frozen_stacks<T>& frozen) {
+    std::pair<stack_pool<T, N>, std::vector<N>> result;
+    stack_pool<T, N>& pool = result.first;
+    const std::vector<std::size_t>& offsets = frozen.offsets();
+    const N block = pool.allocate_block(frozen.values().size());
+
+    result.second.resize(frozen.size(), pool.end());
+    for (std::size_t i = 0; i < frozen.size(); ++i) {
+      if (offsets[i] == offsets[i + 1])
+        continue;
+      result.second[i] = N(block + offsets[i]);
+      for (std::size_t k = offsets[i]; k < offsets[i + 1]; ++k) {
+        const N x = N(block + k);
+        pool.value(x) = frozen.values()[k];
+        pool.next(x) = k + 1 < offsets[i + 1] ? N(x + 1) : pool.end();
+      }
+    }
+    return result;
+  }
+}  // namespace stack_utils
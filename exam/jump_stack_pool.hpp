@@ -0,0 +1,186 @@
+#pragma once
+
+#include "stack_pool.hpp"
+#include <stdexcept>
+#include <utility>
+
+/**
+ * @brief A pool of stacks supporting positional access in O(log n).
+ *
+ * Besides `next`, each node stores its depth (the size of the stack it is
+ * the head of) and a jump pointer to some node below it, as in Myers'
+ * applicative random-access stacks. Jump pointers are chosen on push, in
+ * O(1), so that the distances they cover follow the skew-binary number
+ * system: from any node, the node at any depth is reached with O(log n)
+ * jumps or steps. Nodes below a head never change, so pop and free_stack
+ * need no extra work, and the additional memory is two indices per node.
+ *
+ * Everything else works as in stack_pool, which is used to store the nodes.
+ *
+ * @tparam T Type of the values to be held in the stacks of this pool.
+ * @tparam N Type using to designate the head of a stack.
+ */
+template <typename T, typename N = std::size_t>
+class jump_stack_pool {
+  struct jump_value {
+    T value;
+    N jump;
+    N depth;
+  };
+
+  stack_pool<jump_value, N> pool;
+
+  using stack_type = N;
+  using size_type = std::size_t;
+
+  stack_type jump(stack_type x) const { return pool.value(x).jump; }
+
+  template <typename X>
+  stack_type _push(X&& val, stack_type head) {
+    stack_type j = head;
+    if (!empty(head)) {
+      stack_type y = jump(head);
+      // two jumps of the same length are merged in a longer one
+      if (!empty(y) && depth(head) - depth(y) == depth(y) - depth(jump(y)))
+        j = jump(y);
+    }
+    return pool.push(
+        jump_value{std::forward<X>(val), j, stack_type(depth(head) + 1)},
+        head);
+  }
+
+ public:
+  jump_stack_pool() = default;
+
+  /**
+   * @brief Construct a new pool having a given initial capacity.
+   *
+   * @param n The initial capacity of the pool.
+   */
+  explicit jump_stack_pool(size_type n) : pool{n} {}
+
+  stack_type new_stack() noexcept { return pool.new_stack(); }
+  void reserve(size_type n) { pool.reserve(n); }
+  size_type capacity() const noexcept { return pool.capacity(); }
+  bool empty(stack_type x) const noexcept { return pool.empty(x); }
+  stack_type end() const noexcept { return pool.end(); }
+
+  /**
+   * @brief Return the front value in the given stack.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param x
+   * @return T&
+   */
+  T& value(stack_type x) { return pool.value(x).value; }
+  const T& value(stack_type x) const { return pool.value(x).value; }
+
+  /**
+   * @brief Return the next node in the given stack.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param x
+   * @return stack_type
+   */
+  stack_type next(stack_type x) const { return pool.next(x); }
+
+  /**
+   * @brief Return the size of the stack starting at `x`, in O(1).
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param x
+   * @return size_type
+   */
+  size_type depth(stack_type x) const {
+    return empty(x) ? 0 : pool.value(x).depth;
+  }
+
+  /**
+   * @brief Return the stack starting at `x` without its top `k` values, in
+   * O(log n). The result is `end()` if `k` is not smaller than the size of
+   * the stack.
+   *
+   * The top `k` nodes are not freed: they can still be reached from `x`,
+   * like any other portion of a stack.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param x Head of the stack.
+   * @param k Number of values to be skipped.
+   * @return stack_type
+   */
+  stack_type drop(stack_type x, size_type k) const {
+    if (k >= depth(x))
+      return end();
+
+    const size_type target = depth(x) - k;
+    while (depth(x) != target) {
+      stack_type j = jump(x);
+      x = depth(j) >= target ? j : next(x);
+    }
+    return x;
+  }
+
+  /**
+   * @brief Return the `k`-th value from the top (`k == 0` is the top) of the
+   * stack starting at `x`, in O(log n).
+   *
+   * This method throws std::out_of_range if the stack has no `k`-th value.
+   *
+   * @param x Head of the stack.
+   * @param k
+   * @return const T&
+   */
+  const T& at(stack_type x, size_type k) const {
+    if (k >= depth(x))
+      throw std::out_of_range("The stack is not that deep.");
+    return value(drop(x, k));
+  }
+  T& at(stack_type x, size_type k) {
+    if (k >= depth(x))
+      throw std::out_of_range("The stack is not that deep.");
+    return value(drop(x, k));
+  }
+
+  /**
+   * @brief Push an element to the front of the stack. Returns the new head of
+   * the stack.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool (its jump pointer is needed).
+   *
+   * @param val Value to be pushed.
+   * @param head Head of the stack.
+   * @return stack_type
+   */
+  stack_type push(const T& val, stack_type head) { return _push(val, head); }
+  stack_type push(T&& val, stack_type head) {
+    return _push(std::move(val), head);
+  }
+
+  /**
+   * @brief Pop the head of the given stack. See stack_pool::pop.
+   */
+  stack_type pop(stack_type head) { return pool.pop(head); }
+
+  /**
+   * @brief Empty the given stack. See stack_pool::free_stack.
+   */
+  stack_type free_stack(stack_type head) { return pool.free_stack(head); }
+
+  /**
+   * @brief Call `f` on each value of the given stack, from top to bottom.
+   * See stack_pool::for_each.
+   */
+  template <typename F>
+  void for_each(stack_type x, F f) const {
+    pool.for_each(x, [&f](const jump_value& v) { f(v.value); });
+  }
+};
@@ -0,0 +1,327 @@
+#pragma once
+
+#include "stack_pool.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace stack_utils {
+  namespace detail {
+    /**
+     * @brief Split the heads in at most `parts` contiguous ranges having
+     * about the same total length. A range is never empty.
+     *
+     * @param lengths (Estimated) length of each stack.
+     * @param parts
+     * @return std::vector<std::size_t> The boundaries of the ranges, i.e.
+     *            range `k` is `[b[k], b[k+1])`.
+     */
+    inline std::vector<std::size_t> balanced_partition(
+        const std::vector<std::size_t>& lengths,
+        std::size_t parts) {
+      // each head has some fixed cost, even if the stack is empty
+      std::size_t total = lengths.size();
+      for (auto l : lengths)
+        total += l;
+
+      std::vector<std::size_t> bounds{0};
+      std::size_t acc = 0;
+      for (std::size_t i = 0; i < lengths.size(); ++i) {
+        acc += lengths[i] + 1;
+        // cut as soon as we reach the next multiple of total / parts
+        if (acc * parts >= bounds.size() * total || i + 1 == lengths.size())
+          bounds.push_back(i + 1);
+      }
+      return bounds;
+    }
+
+    /**
+     * @brief Call `g(first, last)` on ranges of the `n` heads, in parallel.
+     *
+     * If `lengths` is empty the ranges are small and the pool balances the
+     * work by stealing, otherwise ranges are balanced by length, and it
+     * must hold the length of each of the `n` heads.
+     */
+    template <typename G>
+    void for_each_range(work_stealing_pool& tp,
+                        std::size_t n,
+                        const std::vector<std::size_t>& lengths,
+                        G g) {
+      if (!lengths.empty() && lengths.size() != n)
+        throw std::invalid_argument(
+            "There must be one length for each head.");
+      if (lengths.empty()) {
+        tp.parallel_for(n, [&g](std::size_t i) { g(i, i + 1); });
+        return;
+      }
+      auto bounds = balanced_partition(lengths, 4 * tp.size());
+      tp.parallel_for(
+          bounds.size() - 1,
+          [&g, &bounds](std::size_t k) { g(bounds[k], bounds[k + 1]); }, 1);
+    }
+
+    /**
+     * @brief Append to `pool` the stacks described by the pairs
+     * `(stack_id, value)` of `n_chunks` chunks, and return the head of stack
+     * `i` at index `i` (see parallel_bulk_build). `chunk(c)` returns the
+     * `[begin, end)` random access iterators of chunk `c`, and the pairs are
+     * taken in the order of the chunks.
+     *
+     * Besides the new nodes, this allocates `n_chunks * n_stacks` counters.
+     * The pool is not modified if an exception is thrown.
+     */
+    template <typename T, typename N, typename Chunk>
+    std::vector<N> bulk_build_into(work_stealing_pool& tp,
+                                   stack_pool<T, N>& pool,
+                                   std::size_t n_chunks,
+                                   Chunk chunk,
+                                   std::size_t n_stacks) {
+      // counts[c][s] is the number of pairs of stack s in chunk c, and then
+      // the number of pairs of stack s in the chunks before c
+      std::vector<std::vector<std::size_t>> counts(n_chunks);
+      tp.parallel_for(
+          n_chunks,
+          [&](std::size_t c) {
+            counts[c].assign(n_stacks, 0);
+            const auto range = chunk(c);
+            for (auto it = range.first; it != range.second; ++it) {
+              const std::size_t s = std::size_t(it->first);
+              if (s >= n_stacks)
+                throw std::out_of_range("Invalid stack id.");
+              ++counts[c][s];
+            }
+          },
+          1);
+
+      std::vector<std::size_t> lengths(n_stacks, 0);
+      tp.parallel_for(n_stacks, [&](std::size_t s) {
+        for (auto& counted : counts) {
+          const std::size_t before = lengths[s];
+          lengths[s] += counted[s];
+          counted[s] = before;
+        }
+      });
+      // offsets[s] is the position of the head of stack s in the block
+      std::vector<std::size_t> offsets(n_stacks);
+      std::size_t total = 0;
+      for (std::size_t s = 0; s < n_stacks; ++s) {
+        offsets[s] = total;
+        total += lengths[s];
+      }
+
+      std::vector<N> heads(n_stacks);
+      const N block = pool.allocate_block(total);
+
+      // the j-th pair of stack s is at distance lengths[s] - 1 - j from the
+      // head, and the first one is the bottom of the stack
+      tp.parallel_for(
+          n_chunks,
+          [&](std::size_t c) {
+            std::vector<std::size_t>& rank = counts[c];
+            const auto range = chunk(c);
+            for (auto it = range.first; it != range.second; ++it) {
+              const std::size_t s = std::size_t(it->first);
+              const std::size_t j = rank[s]++;
+              const N x = N(block + offsets[s] + lengths[s] - 1 - j);
+              pool.value(x) = it->second;
+              pool.next(x) = j == 0 ? pool.end() : N(x + 1);
+            }
+          },
+          1);
+
+      for (std::size_t s = 0; s < n_stacks; ++s)
+        heads[s] = lengths[s] ? N(block + offsets[s]) : pool.end();
+      return heads;
+    }
+  }  // namespace detail
+
+  /**
+   * @brief Compute the size of each of the given stacks, in parallel. The
+   * stacks are not modified.
+   *
+   * This function throws an exception if some head is not a valid index in
+   * the pool.
+   *
+   * @tparam value_type Type of the values held in the stack pool.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @param tp Thread pool running the computation.
+   * @param pool Stack pool containing the stacks.
+   * @param heads Heads of the stacks to be measured.
+   * @return std::vector<std::size_t> The size of `heads[i]` at index `i`.
+   */
+  template <typename value_type, typename stack_type>
+  std::vector<std::size_t> parallel_stack_sizes(
+      work_stealing_pool& tp,
+      const stack_pool<value_type, stack_type>& pool,
+      const std::vector<stack_type>& heads) {
+    std::vector<std::size_t> sizes(heads.size());
+    tp.parallel_for(heads.size(), [&](std::size_t i) {
+      sizes[i] = stack_size(pool, heads[i]);
+    });
+    return sizes;
+  }
+
+  /**
+   * @brief Apply `f` to each value of the given stacks, in parallel. The
+   * stacks are not modified.
+   *
+   * If `lengths` is given (for instance the result of a previous call to
+   * parallel_stack_sizes), the heads are split among the threads so that
+   * each one visits about the same number of nodes, and the results are
+   * allocated in one shot. Otherwise the load is balanced by work stealing.
+   *
+   * This function throws an exception if some head is not a valid index in
+   * the pool, and std::invalid_argument if `lengths` is neither empty nor as
+   * long as `heads`.
+   *
+   * @tparam value_type Type of the values held in the stack pool.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @tparam F A callable object taking a `const value_type&`.
+   * @param tp Thread pool running the computation.
+   * @param pool Stack pool containing the stacks.
+   * @param heads Heads of the stacks to be transformed.
+   * @param f
+   * @param lengths (Estimated) size of each stack, may be empty.
+   * @return std::vector<std::vector<R>> The results for the stack `heads[i]`
+   *            (top to bottom) at index `i`.
+   */
+  template <typename value_type, typename stack_type, typename F>
+  auto parallel_transform(work_stealing_pool& tp,
+                          const stack_pool<value_type, stack_type>& pool,
+                          const std::vector<stack_type>& heads,
+                          F f,
+                          const std::vector<std::size_t>& lengths = {})
+      -> std::vector<
+          std::vector<std::decay_t<decltype(f(std::declval<value_type>()))>>> {
+    using result_type =
+        std::decay_t<decltype(f(std::declval<value_type>()))>;
+    std::vector<std::vector<result_type>> out(heads.size());
+
+    detail::for_each_range(
+        tp, heads.size(), lengths, [&](std::size_t first, std::size_t last) {
+          for (std::size_t i = first; i < last; ++i) {
+            if (!lengths.empty())
+              out[i].reserve(lengths[i]);
+            for (auto it = pool.cbegin(heads[i]); it != pool.cend(heads[i]);
+                 ++it)
+              out[i].push_back(f(*it));
+          }
+        });
+    return out;
+  }
+
+  /**
+   * @brief Reduce all the values of the given stacks using `op`, in
+   * parallel. The stacks are not modified.
+   *
+   * `op` must be associative: values are reduced in the order of `heads`
+   * (top to bottom for each stack), but the grouping depends on the number
+   * of threads. `init` is used exactly once.
+   *
+   * See parallel_transform for the meaning of `lengths`.
+   *
+   * This function throws an exception if some head is not a valid index in
+   * the pool, and std::invalid_argument if `lengths` is neither empty nor as
+   * long as `heads`.
+   *
+   * @tparam value_type Type of the values held in the stack pool.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @tparam R Type of the result.
+   * @tparam Op A callable object taking an `R` and a `value_type`, or two
+   *            `R`, and returning an `R`.
+   * @param tp Thread pool running the computation.
+   * @param pool Stack pool containing the stacks.
+   * @param heads Heads of the stacks to be reduced.
+   * @param init
+   * @param op
+   * @param lengths (Estimated) size of each stack, may be empty.
+   * @return R
+   */
+  template <typename value_type, typename stack_type, typename R, typename Op>
+  R parallel_reduce(work_stealing_pool& tp,
+                    const stack_pool<value_type, stack_type>& pool,
+                    const std::vector<stack_type>& heads,
+                    R init,
+                    Op op,
+                    const std::vector<std::size_t>& lengths = {}) {
+    // the partial result of a range is stored at its first index
+    std::vector<R> partial(heads.size());
+    std::vector<char> has_partial(heads.size(), false);
+
+    detail::for_each_range(
+        tp, heads.size(), lengths, [&](std::size_t first, std::size_t last) {
+          for (std::size_t i = first; i < last; ++i) {
+            for (auto it = pool.cbegin(heads[i]); it != pool.cend(heads[i]);
+                 ++it) {
+              if (has_partial[first]) {
+                partial[first] = op(std::move(partial[first]), *it);
+              } else {
+                partial[first] = R(*it);
+                has_partial[first] = true;
+              }
+            }
+          }
+        });
+
+    for (std::size_t i = 0; i < heads.size(); ++i)
+      if (has_partial[i])
+        init = op(std::move(init), std::move(partial[i]));
+    return init;
+  }
+
+  /**
+   * @brief Build a new pool holding the stacks described by the pairs
+   * `(stack_id, value)` in `[first, last)`, in parallel. The result is the
+   * same as pushing the values in order, `heads[stack_id] =
+   * pool.push(value, heads[stack_id])`, except for the placement of the
+   * nodes.
+   *
+   * The pairs are counted per stack and per chunk of the input in parallel,
+   * then each stack is given a contiguous range of nodes (head first, so
+   * that a traversal visits increasing addresses) and each chunk writes its
+   * values and their precomputed links directly at their final place. The
+   * input is read twice, and no push is done.
+   *
+   * This function throws std::out_of_range if some `stack_id` is not
+   * smaller than `n_stacks`, and std::length_error if the nodes would not be
+   * addressable by N.
+   *
+   * @tparam T Type of the values held in the stack pool.
+   * @tparam N Type of "pointers" to stack nodes.
+   * @tparam RandomIt A random access iterator to pairs whose `first` is the
+   *            id of a stack and whose `second` is convertible to `T`.
+   * @param tp Thread pool running the computation.
+   * @param first
+   * @param last
+   * @param n_stacks Number of stacks, i.e. an upper bound on the ids.
+   * @return std::pair<stack_pool<T, N>, std::vector<N>> The pool, and the
+   *            head of stack `i` at index `i`.
+   */
+  template <typename T, typename N, typename RandomIt>
+  std::pair<stack_pool<T, N>, std::vector<N>> parallel_bulk_build(
+      work_stealing_pool& tp,
+      RandomIt first,
+      RandomIt last,
+      std::size_t n_stacks) {
+    const std::size_t n = std::size_t(last - first);
+    // one chunk per thread, so that the counters take n_stacks * threads
+    const std::size_t n_chunks =
+        std::max<std::size_t>(1, std::min(tp.size(), n / 1024));
+    auto chunk_begin = [n, n_chunks](std::size_t c) {
+      return n / n_chunks * c + std::min(c, n % n_chunks);
+    };
+
+    std::pair<stack_pool<T, N>, std::vector<N>> result;
+    result.second = detail::bulk_build_into(
+        tp, result.first, n_chunks,
+        [&](std::size_t c) {
+          return std::make_pair(first + chunk_begin(c),
+                                first + chunk_begin(c + 1));
+        },
+        n_stacks);
+    return result;
+  }
+}  // namespace stack_utils
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "stack_pool.hpp"
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * @brief A pool of immutable stacks which share their tails.
+ *
+ * Each head returned by the pool is a handle owning one reference to its
+ * node, and each node owns one reference to the node below it. copy()
+ * duplicates a handle in O(1): to keep an older version of a stack, push to
+ * (or pop from) a copy of its head, and both versions will share all the
+ * nodes of the older one. push, pop and free_stack consume the given handle,
+ * as in stack_pool, and reclaim only the nodes which are not referenced
+ * anymore.
+ *
+ * Since nodes may be shared, values cannot be modified once pushed.
+ *
+ * If HashConsing is true, pushing a value on top of a tail which already has
+ * a node holding an equal value returns that node, so that identical stacks
+ * built independently share all their nodes. The nodes are then indexed by a
+ * hash table, which requires `std::hash<T>` and `operator==` for `T`. They
+ * are not required otherwise.
+ *
+ * The nodes are stored in a stack_pool.
+ *
+ * @tparam T Type of the values to be held in the stacks of this pool.
+ * @tparam N Type using to designate the head of a stack.
+ * @tparam HashConsing Whether equal nodes are shared.
+ */
+template <typename T, typename N = std::size_t, bool HashConsing = false>
+class persistent_stack_pool {
+  struct counted_value {
+    T value;
+    std::uint32_t refs;
+  };
+
+  stack_pool<counted_value, N> pool;
+
+  // nodes indexed by the hash of their value and next node. Used only if
+  // HashConsing
+  std::unordered_multimap<std::size_t, N> index;
+
+  using stack_type = N;
+  // the functions which need std::hash<T> are chosen by tag dispatch, so
+  // that they are not instantiated if HashConsing is false
+  using hash_consing = std::integral_constant<bool, HashConsing>;
+  using size_type = std::size_t;
+
+  std::uint32_t& refs(stack_type x) { return pool.value(x).refs; }
+
+  void acquire(stack_type x) {
+    if (empty(x))
+      return;
+    if (refs(x) == std::numeric_limits<std::uint32_t>::max())
+      throw std::overflow_error("Too many references to the same node.");
+    ++refs(x);
+  }
+
+  static std::size_t hash(const T& val, stack_type next) {
+    std::size_t h = std::hash<T>{}(val);
+    return h ^ (std::hash<stack_type>{}(next) + 0x9e3779b97f4a7c15ull +
+                (h << 6) + (h >> 2));
+  }
+
+  // return the node holding `val` on top of `next`, or end() if there is none
+  stack_type find(const T& val, stack_type next, std::size_t h) const {
+    auto range = index.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it)
+      if (pool.next(it->second) == next && value(it->second) == val)
+        return it->second;
+    return end();
+  }
+
+  void unindex(stack_type, std::false_type) noexcept {}
+  void unindex(stack_type x, std::true_type) {
+    auto range = index.equal_range(hash(value(x), next(x)));
+    for (auto it = range.first; it != range.second; ++it)
+      if (it->second == x) {
+        index.erase(it);
+        return;
+      }
+  }
+
+  template <typename X>
+  stack_type _push(X&& val, stack_type head, std::false_type) {
+    // the reference held by the caller is transferred to the new node
+    return pool.push(counted_value{std::forward<X>(val), 1}, head);
+  }
+  template <typename X>
+  stack_type _push(X&& val, stack_type head, std::true_type) {
+    const std::size_t h = hash(val, head);
+    stack_type x = find(val, head, h);
+    if (!empty(x)) {
+      // x already holds its own reference to head
+      acquire(x);
+      free_stack(head);
+      return x;
+    }
+    x = _push(std::forward<X>(val), head, std::false_type{});
+    index.emplace(h, x);
+    return x;
+  }
+
+ public:
+  persistent_stack_pool() noexcept {}
+
+  /**
+   * @brief Construct a new pool having a given initial capacity.
+   *
+   * @param n The initial capacity of the pool.
+   */
+  explicit persistent_stack_pool(size_type n) : pool{n} {}
+
+  stack_type new_stack() noexcept { return pool.new_stack(); }
+  void reserve(size_type n) { pool.reserve(n); }
+  size_type capacity() const noexcept { return pool.capacity(); }
+  bool empty(stack_type x) const noexcept { return pool.empty(x); }
+  stack_type end() const noexcept { return pool.end(); }
+
+  /**
+   * @brief Return the number of nodes belonging to some stack. Shared nodes
+   * are counted once.
+   */
+  size_type count_nodes() const noexcept { return pool.count_live(); }
+
+  /**
+   * @brief Return the front value in the given stack.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param x
+   * @return const T&
+   */
+  const T& value(stack_type x) const { return pool.value(x).value; }
+
+  /**
+   * @brief Return the next node in the given stack. The result does not own
+   * a reference: use copy() to keep it after `x` is released.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param x
+   * @return stack_type
+   */
+  stack_type next(stack_type x) const { return pool.next(x); }
+
+  /**
+   * @brief Return the number of references (handles and nodes above it) to
+   * the given node, 0 for `end()`.
+   *
+   * @param x
+   * @return std::size_t
+   */
+  std::size_t use_count(stack_type x) const {
+    return empty(x) ? 0 : pool.value(x).refs;
+  }
+
+  /**
+   * @brief Return a new handle to the stack starting at `x`, in O(1). Both
+   * handles must be released.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param x
+   * @return stack_type
+   */
+  stack_type copy(stack_type x) {
+    acquire(x);
+    return x;
+  }
+
+  /**
+   * @brief Push an element to the front of the stack. Returns the new head of
+   * the stack, and consumes the handle `head`.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param val Value to be pushed.
+   * @param head Head of the stack.
+   * @return stack_type
+   */
+  stack_type push(const T& val, stack_type head) {
+    return _push(val, head, hash_consing{});
+  }
+  stack_type push(T&& val, stack_type head) {
+    return _push(std::move(val), head, hash_consing{});
+  }
+
+  /**
+   * @brief Release the handle `head` and return a handle to the stack below
+   * it. The node is reclaimed if it is not referenced anymore.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param head
+   * @return stack_type
+   */
+  stack_type pop(stack_type head) {
+    stack_type below = next(head);
+    if (refs(head) == 1) {
+      // the reference held by the node is transferred to the caller
+      unindex(head, hash_consing{});
+      pool.pop(head);
+    } else {
+      --refs(head);
+      acquire(below);
+    }
+    return below;
+  }
+
+  /**
+   * @brief Release the handle `head`, reclaiming all the nodes which are not
+   * referenced anymore. Returns `end()`.
+   *
+   * This method throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @param head
+   * @return stack_type
+   */
+  stack_type free_stack(stack_type head) {
+    // stop at the first node which is still referenced from somewhere else
+    while (!empty(head) && --refs(head) == 0) {
+      unindex(head, hash_consing{});
+      head = pool.pop(head);
+    }
+    return end();
+  }
+
+  /**
+   * @brief Check whether equal nodes are shared (see HashConsing).
+   */
+  static constexpr bool hash_conses() noexcept { return HashConsing; }
+
+  /**
+   * @brief Call `f` on each value of the given stack, from top to bottom.
+   * See stack_pool::for_each.
+   */
+  template <typename F>
+  void for_each(stack_type x, F f) const {
+    pool.for_each(x, [&f](const counted_value& v) { f(v.value); });
+  }
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "batched_traversal.hpp"
+#include "stack_pool.hpp"
+#include <ostream>
+#include <vector>
+
+namespace stack_utils {
+  /**
+   * @brief Compute the distribution of the lengths of the given stacks. The
+   * stacks are not modified.
+   *
+   * Bucket 0 counts the empty stacks, bucket `k > 0` the stacks whose length
+   * is in `[2^(k-1), 2^k)`. Trailing empty buckets are omitted. The stacks
+   * are measured with batched_stack_sizes.
+   *
+   * This function throws an exception if some head is not a valid index in
+   * the pool.
+   *
+   * @tparam value_type Type of the values held in the stack pool.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @param pool Stack pool containing the stacks.
+   * @param heads Heads of the stacks to be measured.
+   * @return std::vector<std::size_t>
+   */
+  template <typename value_type, typename stack_type>
+  std::vector<std::size_t> stack_length_histogram(
+      const stack_pool<value_type, stack_type>& pool,
+      const std::vector<stack_type>& heads) {
+    std::vector<std::size_t> histogram;
+    for (std::size_t length : batched_stack_sizes(pool, heads)) {
+      std::size_t bucket = 0;
+      for (; length != 0; length >>= 1)
+        ++bucket;
+      if (histogram.size() <= bucket)
+        histogram.resize(bucket + 1, 0);
+      ++histogram[bucket];
+    }
+    return histogram;
+  }
+
+  /**
+   * @brief Write the given statistics (and optionally a histogram of the
+   * lengths of the stacks) as a JSON object.
+   *
+   * @param os An output stream.
+   * @param s The statistics of a pool (see stack_pool::stats).
+   * @param histogram The result of stack_length_histogram, may be empty.
+   */
+  inline void write_json(std::ostream& os,
+                         const stack_pool_stats& s,
+                         const std::vector<std::size_t>& histogram = {}) {
+    os << "{\"events\": ";
+    if (s.counts_events)
+      os << "{\"pushes\": " << s.pushes << ", \"pops\": " << s.pops
+         << ", \"free_stacks\": " << s.free_stacks
+         << ", \"reallocations\": " << s.reallocations << '}';
+    else
+      os << "null";
+    os << ", \"nodes\": " << s.nodes << ", \"live_nodes\": " << s.live_nodes
+       << ", \"free_nodes\": " << s.free_nodes
+       << ", \"largest_free_run\": " << s.largest_free_run
+       << ", \"fragmentation\": " << s.fragmentation
+       << ", \"bytes_reserved\": " << s.bytes_reserved
+       << ", \"bytes_used\": " << s.bytes_used << ", \"length_histogram\": [";
+    for (std::size_t k = 0; k < histogram.size(); ++k)
+      os << (k ? ", " : "") << histogram[k];
+    os << "]}";
+  }
+}  // namespace stack_utils
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "stack_pool.hpp"
+#include <iterator>
+
+/**
+ * @brief An iterator over a stack which prefetches the node it is going to
+ * visit next.
+ *
+ * The iterator holds the current node and the index of the following one.
+ * Each increment moves to the following node, whose index is already known,
+ * reads its `next` and prefetches that node. In the meantime the current
+ * value is processed by the caller, so the cache miss overlaps with useful
+ * work instead of stalling the next increment.
+ *
+ * The lookahead is one node: the address of the node after that is stored in
+ * the node being fetched, therefore it cannot be known earlier. Walking
+ * several stacks at the same time (see stack_utils::batched_walk) hides more
+ * latency.
+ *
+ * Compared to stack_iterator, the head is not validated, except by reading
+ * its `next`: an invalid head makes the constructor throw.
+ *
+ * @tparam stack_type Type of "pointers" to stack nodes.
+ * @tparam T Type of the values held in the stack pool (possibly const).
+ * @tparam P Type of the stack pool (possibly const).
+ */
+template <typename stack_type, typename T, typename P>
+class prefetch_iterator {
+  stack_type current_head;
+  stack_type following;
+  P* pool;
+
+  // read-only access, which is never recorded in the undo log of the pool
+  const P* cpool() const noexcept { return pool; }
+
+  // the node after the current one, prefetched
+  stack_type fetch_following() const {
+    if (pool->empty(current_head))
+      return current_head;
+    const stack_type x = cpool()->next(current_head);
+    pool->prefetch(x);
+    return x;
+  }
+
+ public:
+  using value_type = T;
+  using reference = value_type&;
+  using pointer = value_type*;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  prefetch_iterator(stack_type head, P* pool_ptr)
+      : current_head{head}, following{head}, pool{pool_ptr} {
+    following = fetch_following();
+  }
+
+  T& operator*() const { return pool->value(current_head); }
+
+  prefetch_iterator& operator++() {
+    current_head = following;
+    following = fetch_following();
+    return *this;
+  }
+  prefetch_iterator operator++(int) {
+    auto tmp = *this;
+    ++(*this);
+    return tmp;
+  }
+
+  stack_type ptr_to_stack() const noexcept { return current_head; }
+
+  friend bool operator==(const prefetch_iterator& a,
+                         const prefetch_iterator& b) noexcept {
+    return a.current_head == b.current_head;
+  }
+  friend bool operator!=(const prefetch_iterator& a,
+                         const prefetch_iterator& b) noexcept {
+    return !(a == b);
+  }
+};
+
+namespace stack_utils {
+  /**
+   * @brief Return a prefetch_iterator to the top of the given stack.
+   *
+   * @tparam value_type Type of the values held in the stack pool.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @param pool Stack pool containing the stack referenced by `head`.
+   * @param head Head of the stack to be visited.
+   */
+  template <typename value_type, typename stack_type>
+  prefetch_iterator<stack_type,
+                    const value_type,
+                    const stack_pool<value_type, stack_type>>
+  prefetch_begin(const stack_pool<value_type, stack_type>& pool,
+                 stack_type head) {
+    return {head, &pool};
+  }
+
+  /**
+   * @brief Return a prefetch_iterator past the bottom of any stack.
+   */
+  template <typename value_type, typename stack_type>
+  prefetch_iterator<stack_type,
+                    const value_type,
+                    const stack_pool<value_type, stack_type>>
+  prefetch_end(const stack_pool<value_type, stack_type>& pool, stack_type) {
+    return {pool.end(), &pool};
+  }
+
+  template <typename value_type, typename stack_type>
+  prefetch_iterator<stack_type, value_type, stack_pool<value_type, stack_type>>
+  prefetch_begin(stack_pool<value_type, stack_type>& pool, stack_type head) {
+    return {head, &pool};
+  }
+
+  template <typename value_type, typename stack_type>
+  prefetch_iterator<stack_type, value_type, stack_pool<value_type, stack_type>>
+  prefetch_end(stack_pool<value_type, stack_type>& pool, stack_type) {
+    return {pool.end(), &pool};
+  }
+}  // namespace stack_utils
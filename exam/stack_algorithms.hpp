@@ -0,0 +1,176 @@
+#pragma once
+
+#include "stack_pool.hpp"
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <utility>
+
+// Algorithms which rearrange stacks by relinking their nodes: only the `next`
+// indices are written, values are never moved or copied and nothing is
+// allocated. The nodes of the given stacks end up in the returned stacks, the
+// former heads should not be mentioned anymore.
+//
+// Comparisons and predicates should not throw: if they do, the stacks are
+// left in an unspecified (but valid) state.
+namespace stack_utils {
+  /**
+   * @brief Reverse the stack starting at `head`, in place. Returns the new
+   * head (i.e. the former bottom).
+   *
+   * This function throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @tparam value_type Type of the values held in the stack pool.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @param pool Stack pool containing the stack referenced by `head`.
+   * @param head Head of the stack to be reversed.
+   * @return stack_type
+   */
+  template <typename value_type, typename stack_type>
+  stack_type reverse_stack(stack_pool<value_type, stack_type>& pool,
+                           stack_type head) {
+    stack_type reversed = pool.end();
+    while (!pool.empty(head)) {
+      stack_type& link = pool.next(head);
+      stack_type rest = link;
+      link = reversed;
+      reversed = head;
+      head = rest;
+    }
+    return reversed;
+  }
+
+  /**
+   * @brief Merge two stacks sorted (from top to bottom) according to `comp`
+   * into one sorted stack. Returns its head.
+   *
+   * The merge is stable: equivalent values keep their relative order, and
+   * those coming from `a` precede those coming from `b`.
+   *
+   * This function throws an exception if the given heads are not valid
+   * indexes in the pool.
+   *
+   * @tparam value_type Type of the values held in the stack pool.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @tparam Compare A callable object taking two `const value_type&` and
+   *            returning true if the first is less than the second.
+   * @param pool Stack pool containing the stacks.
+   * @param a Head of the first stack.
+   * @param b Head of the second stack.
+   * @param comp
+   * @return stack_type
+   */
+  template <typename value_type,
+            typename stack_type,
+            typename Compare = std::less<>>
+  stack_type merge_stacks(stack_pool<value_type, stack_type>& pool,
+                          stack_type a,
+                          stack_type b,
+                          Compare comp = Compare{}) {
+    stack_type head = pool.end();
+    // the index to be written when the next node is appended. The pool does
+    // not grow here, so it is safe to keep a pointer to its nodes
+    stack_type* link = &head;
+    while (!pool.empty(a) && !pool.empty(b)) {
+      stack_type& taken = comp(pool.value(b), pool.value(a)) ? b : a;
+      *link = taken;
+      link = &pool.next(taken);
+      taken = *link;
+    }
+    *link = pool.empty(a) ? b : a;
+    return head;
+  }
+
+  /**
+   * @brief Sort the stack starting at `head` (from top to bottom) according
+   * to `comp`. Returns the new head.
+   *
+   * This is a stable bottom-up merge sort taking O(n log n) comparisons: runs
+   * of 2^k nodes are kept in a fixed array of bins, and merged like the
+   * digits of a binary counter when a node is added. Merges follow `next`
+   * across the whole pool, therefore for small values sorting a copy in a
+   * vector may be faster, in spite of moving each value twice.
+   *
+   * This function throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @tparam value_type Type of the values held in the stack pool.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @tparam Compare A callable object taking two `const value_type&` and
+   *            returning true if the first is less than the second.
+   * @param pool Stack pool containing the stack referenced by `head`.
+   * @param head Head of the stack to be sorted.
+   * @param comp
+   * @return stack_type
+   */
+  template <typename value_type,
+            typename stack_type,
+            typename Compare = std::less<>>
+  stack_type sort_stack(stack_pool<value_type, stack_type>& pool,
+                        stack_type head,
+                        Compare comp = Compare{}) {
+    // bins[k] is empty or holds a sorted run of 2^k nodes, which come before
+    // (in the original stack) the nodes held by bins[k-1], ..., bins[0]
+    std::array<stack_type, 8 * sizeof(std::size_t)> bins;
+    bins.fill(pool.end());
+    std::size_t used = 0;
+
+    while (!pool.empty(head)) {
+      stack_type carry = head;
+      head = pool.next(head);
+      pool.next(carry) = pool.end();
+
+      std::size_t k = 0;
+      for (; !pool.empty(bins[k]); ++k) {
+        carry = merge_stacks(pool, bins[k], carry, comp);
+        bins[k] = pool.end();
+      }
+      bins[k] = carry;
+      used = std::max(used, k + 1);
+    }
+
+    stack_type sorted = pool.end();
+    for (std::size_t k = 0; k < used; ++k)
+      sorted = merge_stacks(pool, bins[k], sorted, comp);
+    return sorted;
+  }
+
+  /**
+   * @brief Reorder the stack starting at `head` so that the values satisfying
+   * `pred` precede (from top to bottom) those which do not. The partition is
+   * stable: the relative order inside each group is preserved.
+   *
+   * This function throws an exception if the given head is not a valid index
+   * in the pool.
+   *
+   * @tparam value_type Type of the values held in the stack pool.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @tparam Pred A callable object taking a `const value_type&` and
+   *            returning a bool.
+   * @param pool Stack pool containing the stack referenced by `head`.
+   * @param head Head of the stack to be partitioned.
+   * @param pred
+   * @return std::pair<stack_type, stack_type> The new head, and the first
+   *            node not satisfying `pred` (`pool.end()` if there is none).
+   */
+  template <typename value_type, typename stack_type, typename Pred>
+  std::pair<stack_type, stack_type> partition_stack(
+      stack_pool<value_type, stack_type>& pool,
+      stack_type head,
+      Pred pred) {
+    stack_type yes = pool.end();
+    stack_type no = pool.end();
+    stack_type* yes_link = &yes;
+    stack_type* no_link = &no;
+    while (!pool.empty(head)) {
+      stack_type*& link = pred(pool.value(head)) ? yes_link : no_link;
+      *link = head;
+      link = &pool.next(head);
+      head = *link;
+    }
+    *no_link = pool.end();
+    *yes_link = no;
+    return {yes, no};
+  }
+}  // namespace stack_utils
@@ -0,0 +1,271 @@
+#pragma once
+
+#include "frozen_stacks.hpp"
+#include "stack_pool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Archive format for stacks of integers. All the numbers are unsigned LEB128
+// varints (7 bits per byte, least significant first), so the format does not
+// depend on the byte order or on the type of the pool:
+//
+//   archive := "psarch1\n" block_values n_stacks stack*
+//   stack   := length block*
+//   block   := n_bytes zigzag(first value) zigzag(delta)*
+//
+// A block holds up to `block_values` values of a stack, from the top, and is
+// decoded independently of the others: its first value is stored as is, the
+// next ones as the difference from the previous value. Differences are
+// zig-zag encoded, so that small negative ones take a byte too. n_bytes is
+// the size of the rest of the block, which allows skipping it.
+
+namespace stack_utils {
+  namespace detail {
+    constexpr char archive_magic[8] = {'p', 's', 'a', 'r', 'c', 'h', '1', '\n'};
+    // the largest block_values which read_archive accepts
+    constexpr std::uint64_t max_block_values = 1 << 24;
+
+    inline void check_block_values(std::size_t block_values) {
+      if (block_values == 0 || block_values > max_block_values)
+        throw std::invalid_argument(
+            "Blocks must hold between 1 and 2^24 values.");
+    }
+
+    // at most 10 bytes for 64 bits
+    inline char* put_varint(char* out, std::uint64_t x) noexcept {
+      while (x >= 0x80) {
+        *out++ = char(x | 0x80);
+        x >>= 7;
+      }
+      *out++ = char(x);
+      return out;
+    }
+
+    // return nullptr if the varint is longer than 64 bits or truncated
+    inline const char* get_varint(const char* in,
+                                  const char* last,
+                                  std::uint64_t& x) noexcept {
+      x = 0;
+      for (unsigned shift = 0; shift < 64 && in != last; shift += 7) {
+        const std::uint64_t byte = static_cast<unsigned char>(*in++);
+        x |= (byte & 0x7f) << shift;
+        if (byte < 0x80)
+          return in;
+      }
+      return nullptr;
+    }
+
+    inline void write_varint(std::ostream& os, std::uint64_t x) {
+      char buffer[10];
+      os.write(buffer, put_varint(buffer, x) - buffer);
+    }
+
+    inline std::uint64_t read_varint(std::istream& is) {
+      std::uint64_t x = 0;
+      for (unsigned shift = 0; shift < 64; shift += 7) {
+        const int byte = is.get();
+        if (byte == std::char_traits<char>::eof())
+          throw std::runtime_error("The archive is truncated.");
+        x |= std::uint64_t(byte & 0x7f) << shift;
+        if (byte < 0x80)
+          return x;
+      }
+      throw std::runtime_error("Invalid varint in the archive.");
+    }
+
+    // differences are computed modulo 2^bits of T, and sign-extended to 64
+    // bits before the zig-zag encoding
+    template <typename T>
+    std::uint64_t zigzag(T previous, T x) noexcept {
+      using U = std::make_unsigned_t<T>;
+      using S = std::make_signed_t<T>;
+      const std::int64_t d = S(U(U(x) - U(previous)));
+      return (std::uint64_t(d) << 1) ^ std::uint64_t(d >> 63);
+    }
+    template <typename T>
+    T unzigzag(T previous, std::uint64_t z) noexcept {
+      using U = std::make_unsigned_t<T>;
+      const std::uint64_t d = (z >> 1) ^ (0 - (z & 1));
+      return T(U(U(previous) + U(d)));
+    }
+
+    /**
+     * @brief Write the `length` values of `[first, last)` as a stack of the
+     * archive. `block` is a buffer of `10 * block_values` bytes.
+     */
+    template <typename It>
+    void write_archived_stack(std::ostream& os,
+                              It first,
+                              It last,
+                              std::size_t length,
+                              std::size_t block_values,
+                              std::vector<char>& block) {
+      using T = std::decay_t<decltype(*first)>;
+      write_varint(os, length);
+      while (first != last) {
+        char* out = block.data();
+        T previous = *first;
+        out = put_varint(out, zigzag(T(0), previous));
+        ++first;
+        for (std::size_t k = 1; k < block_values && first != last;
+             ++k, ++first) {
+          out = put_varint(out, zigzag(previous, *first));
+          previous = *first;
+        }
+        write_varint(os, std::uint64_t(out - block.data()));
+        os.write(block.data(), out - block.data());
+      }
+    }
+  }  // namespace detail
+
+  /**
+   * @brief Write the given stacks of integers to a compressed archive, where
+   * stack `i` is `heads[i]`. The pool is not modified.
+   *
+   * The values are encoded with deltas and zig-zag varints in blocks of
+   * `block_values` values (see the format above), while each stack is
+   * visited: sorted or clustered stacks take one or two bytes per value.
+   * Heads and links are not stored. Stacks which share their tail are
+   * written entirely.
+   *
+   * This function throws an exception if some head is not a valid index in
+   * the pool, and std::invalid_argument if `block_values` is 0 or larger
+   * than 2^24 (read_archive would reject the archive).
+   *
+   * @tparam value_type Type of the values held in the stack pool, an
+   *            integral type.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @param os A binary output stream.
+   * @param pool Stack pool containing the stacks.
+   * @param heads Heads of the stacks to be written.
+   * @param block_values Maximum number of values per block.
+   */
+  template <typename value_type, typename stack_type>
+  void write_archive(std::ostream& os,
+                     const stack_pool<value_type, stack_type>& pool,
+                     const std::vector<stack_type>& heads,
+                     std::size_t block_values = 256) {
+    static_assert(std::is_integral<value_type>::value,
+                  "Only stacks of integers can be archived.");
+    detail::check_block_values(block_values);
+    os.write(detail::archive_magic, sizeof(detail::archive_magic));
+    detail::write_varint(os, block_values);
+    detail::write_varint(os, heads.size());
+    std::vector<char> block(10 * block_values);
+    for (stack_type h : heads)
+      detail::write_archived_stack(os, pool.cbegin(h), pool.cend(h),
+                                   stack_size(pool, h), block_values, block);
+  }
+
+  /**
+   * @brief Write the given frozen stacks to a compressed archive. See
+   * write_archive for a stack_pool.
+   */
+  template <typename T>
+  void write_archive(std::ostream& os,
+                     const frozen_stacks<T>& frozen,
+                     std::size_t block_values = 256) {
+    static_assert(std::is_integral<T>::value,
+                  "Only stacks of integers can be archived.");
+    detail::check_block_values(block_values);
+    os.write(detail::archive_magic, sizeof(detail::archive_magic));
+    detail::write_varint(os, block_values);
+    detail::write_varint(os, frozen.size());
+    std::vector<char> block(10 * block_values);
+    for (std::size_t i = 0; i < frozen.size(); ++i)
+      detail::write_archived_stack(os, frozen.begin(i), frozen.end(i),
+                                   frozen.length(i), block_values, block);
+  }
+
+  /**
+   * @brief Read the stacks of an archive into new stacks of `pool`, and
+   * return the head of stack `i` at index `i`.
+   *
+   * Blocks are read one at a time and decoded into the nodes. The
+   * nodes of each stack are contiguous, from the top to the bottom (see
+   * stack_pool::allocate_block). Differences are added modulo 2^bits of
+   * `value_type`, which should be the type of the archived pool.
+   *
+   * This function throws std::runtime_error if the stream does not hold a
+   * valid archive, and std::length_error if the nodes are not addressable
+   * by N. The nodes read before the error stay in the pool as garbage (see
+   * stack_pool::reclaim_unreachable). Memory is allocated as the blocks are
+   * read, so a corrupted length cannot cause a huge allocation.
+   *
+   * @tparam value_type Type of the values held in the stack pool, an
+   *            integral type.
+   * @tparam stack_type Type of "pointers" to stack nodes.
+   * @param is A binary input stream.
+   * @param pool
+   * @return std::vector<stack_type>
+   */
+  template <typename value_type, typename stack_type>
+  std::vector<stack_type> read_archive(
+      std::istream& is,
+      stack_pool<value_type, stack_type>& pool) {
+    static_assert(std::is_integral<value_type>::value,
+                  "Only stacks of integers can be archived.");
+    char magic[sizeof(detail::archive_magic)];
+    if (!is.read(magic, sizeof(magic)) ||
+        !std::equal(magic, magic + sizeof(magic), detail::archive_magic))
+      throw std::runtime_error("Not a stack archive.");
+
+    const std::uint64_t block_values = detail::read_varint(is);
+    if (block_values == 0 || block_values > detail::max_block_values)
+      throw std::runtime_error("Invalid block size in the archive.");
+    const std::uint64_t n_stacks = detail::read_varint(is);
+
+    std::vector<stack_type> heads;
+    std::vector<char> block;
+    std::vector<value_type> values;
+    values.reserve(block_values);
+    for (std::uint64_t i = 0; i < n_stacks; ++i) {
+      const std::uint64_t length = detail::read_varint(is);
+      heads.push_back(pool.end());
+
+      // the nodes are allocated block by block, rather than trusting the
+      // length, and are contiguous since nothing else is allocated
+      std::uint64_t k = 0;
+      while (k < length) {
+        const std::uint64_t n_bytes = detail::read_varint(is);
+        // a value takes at most 10 bytes
+        if (n_bytes == 0 || n_bytes > 10 * block_values)
+          throw std::runtime_error("Invalid block in the archive.");
+        block.resize(n_bytes);
+        if (!is.read(block.data(), std::streamsize(n_bytes)))
+          throw std::runtime_error("The archive is truncated.");
+
+        values.clear();
+        const char* in = block.data();
+        const char* last = in + n_bytes;
+        value_type previous{0};
+        while (in != last) {
+          std::uint64_t z;
+          in = detail::get_varint(in, last, z);
+          if (!in || values.size() == block_values ||
+              values.size() == length - k)
+            throw std::runtime_error("Invalid block in the archive.");
+          previous = detail::unzigzag(previous, z);
+          values.push_back(previous);
+        }
+
+        const stack_type first = pool.allocate_block(values.size());
+        if (k == 0)
+          heads.back() = first;
+        for (std::size_t j = 0; j < values.size(); ++j) {
+          const stack_type x = stack_type(first + j);
+          pool.value(x) = values[j];
+          pool.next(x) = k + j + 1 < length ? stack_type(x + 1) : pool.end();
+        }
+        k += values.size();
+      }
+    }
+    return heads;
+  }
+}  // namespace stack_utils
@@ -0,0 +1,367 @@
+#pragma once
+
+#include "parallel_utils.hpp"
+#include "stack_pool.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __cplusplus >= 201703L
+#  include <charconv>
+#endif
+
+/**
+ * @brief A file mapped read-only in memory, unmapped by the destructor.
+ *
+ * The constructor throws std::system_error if the file cannot be opened or
+ * mapped.
+ */
+class mapped_file {
+  const char* bytes;
+  std::size_t length;
+
+ public:
+  explicit mapped_file(const std::string& path) : bytes{nullptr}, length{0} {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::system_error(errno, std::generic_category(), path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      const int e = errno;
+      ::close(fd);
+      throw std::system_error(e, std::generic_category(), path);
+    }
+    length = std::size_t(st.st_size);
+    // an empty file cannot be mapped, and has nothing to read
+    if (length != 0) {
+      void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        const int e = errno;
+        ::close(fd);
+        throw std::system_error(e, std::generic_category(), path);
+      }
+      // the file is read once from the beginning (by each thread)
+      ::madvise(p, length, MADV_SEQUENTIAL);
+      bytes = static_cast<const char*>(p);
+    }
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  ~mapped_file() {
+    if (bytes)
+      ::munmap(const_cast<char*>(bytes), length);
+  }
+
+  const char* data() const noexcept { return bytes; }
+  std::size_t size() const noexcept { return length; }
+};
+
+namespace stack_utils {
+  namespace detail {
+    // a floating point number starts with a digit or a dot, possibly after a
+    // minus: this rejects leading whitespace, '+', inf and nan, which are
+    // accepted by strtod (and inf and nan by std::from_chars)
+    inline bool plain_number_start(const char* first, const char* last) {
+      if (first != last && *first == '-')
+        ++first;
+      return first != last &&
+             ((*first >= '0' && *first <= '9') || *first == '.');
+    }
+
+#if __cplusplus >= 201703L
+    /**
+     * @brief Parse a number at the beginning of `[first, last)`, and return
+     * the position after it, or nullptr if there is no valid number.
+     */
+    template <typename X>
+    const char* parse_number(const char* first, const char* last, X& x) {
+      if (std::is_floating_point<X>::value && !plain_number_start(first, last))
+        return nullptr;
+      auto r = std::from_chars(first, last, x);
+      return r.ec == std::errc{} ? r.ptr : nullptr;
+    }
+#else
+    // std::from_chars needs C++17: integers are parsed by hand, floating
+    // point numbers by strtod on a null-terminated copy
+    template <typename X>
+    std::enable_if_t<std::is_integral<X>::value, const char*> parse_number(
+        const char* first,
+        const char* last,
+        X& x) {
+      using U = std::make_unsigned_t<X>;
+      const bool negative =
+          std::is_signed<X>::value && first != last && *first == '-';
+      if (negative)
+        ++first;
+      const U limit = U(std::numeric_limits<X>::max()) + U(negative);
+      U u = 0;
+      const char* p = first;
+      for (; p != last && *p >= '0' && *p <= '9'; ++p) {
+        const U digit = U(*p - '0');
+        if (u > (limit - digit) / 10)
+          return nullptr;
+        u = U(u * 10 + digit);
+      }
+      if (p == first)
+        return nullptr;
+      x = negative ? X(U(0) - u) : X(u);
+      return p;
+    }
+    inline float to_floating(const char* s, char** end, float) {
+      return std::strtof(s, end);
+    }
+    inline double to_floating(const char* s, char** end, double) {
+      return std::strtod(s, end);
+    }
+    inline long double to_floating(const char* s, char** end, long double) {
+      return std::strtold(s, end);
+    }
+    // only the characters of a decimal number are given to strtod, so that
+    // hex floats are not parsed, and the numbers out of range are rejected
+    // as std::from_chars does. The whole token is copied, however long
+    template <typename X>
+    std::enable_if_t<std::is_floating_point<X>::value, const char*>
+    parse_number(const char* first, const char* last, X& x) {
+      if (!plain_number_start(first, last))
+        return nullptr;
+      const char* token_end = first;
+      while (token_end != last && *token_end != '\0' &&
+             std::strchr("0123456789.eE+-", *token_end))
+        ++token_end;
+      const std::size_t n = std::size_t(token_end - first);
+
+      // most numbers fit in `small`, which avoids an allocation
+      char small[64];
+      std::string large;
+      char* buffer = small;
+      if (n < sizeof(small)) {
+        std::memcpy(small, first, n);
+        small[n] = '\0';
+      } else {
+        large.assign(first, n);
+        buffer = &large[0];
+      }
+      char* end = nullptr;
+      errno = 0;
+      const X d = to_floating(buffer, &end, X{});
+      if (end == buffer || errno == ERANGE)
+        return nullptr;
+      x = d;
+      return first + (end - buffer);
+    }
+#endif
+
+    // ids not smaller than this are rejected by default, see ingest_text
+    constexpr std::size_t default_max_stacks = std::size_t(1) << 20;
+
+    // the pairs read by a thread, and the largest stack id among them
+    template <typename T>
+    struct ingested_part {
+      std::vector<std::pair<std::uint32_t, T>> pairs;
+      std::size_t n_stacks = 0;
+    };
+
+    /**
+     * @brief Build the pairs of all the parts, in order, into new stacks of
+     * `pool`. The pairs are laid out directly from the parts, and released
+     * afterwards.
+     */
+    template <typename T, typename N>
+    std::vector<N> build_parts(work_stealing_pool& tp,
+                               std::vector<ingested_part<T>>& parts,
+                               stack_pool<T, N>& pool) {
+      std::size_t n_stacks = 0;
+      for (const auto& p : parts)
+        n_stacks = std::max(n_stacks, p.n_stacks);
+      auto heads = bulk_build_into(
+          tp, pool, parts.size(),
+          [&parts](std::size_t k) {
+            return std::make_pair(parts[k].pairs.cbegin(),
+                                  parts[k].pairs.cend());
+          },
+          n_stacks);
+      parts = {};
+      return heads;
+    }
+  }  // namespace detail
+
+  /**
+   * @brief Read the text file `path` into new stacks of `pool`, and return
+   * the head of stack `i` at index `i`.
+   *
+   * Each line of the file is `stack_id<TAB>value`, where `stack_id` is an
+   * unsigned 32-bit integer and `value` a number of type T, and lines may end
+   * with `\r\n`. Empty lines are ignored. The values of a stack are pushed in
+   * the order of the file, therefore the last one is the head. Stack ids
+   * should be dense, since there is a head (and, while building, a counter
+   * per thread) for each id up to the largest one: ids not smaller than
+   * `max_stacks` are rejected.
+   *
+   * The file is memory mapped and split at line boundaries among the threads
+   * of `tp`, which parse their part with std::from_chars (hand-written
+   * parsers, which accept the same numbers, are used before C++17) into a
+   * vector of pairs per thread. The stacks are then laid out directly from
+   * those vectors into a new block of `pool` (see parallel_bulk_build).
+   * Besides the file and the new nodes, the peak memory is the parsed pairs
+   * and `threads * (largest id + 1)` counters.
+   *
+   * This function throws std::system_error if the file cannot be read,
+   * std::runtime_error (with the offset of the line) if a line is malformed
+   * or its id is too large, and std::length_error if the nodes are not
+   * addressable by N. The pool is not modified in these cases.
+   *
+   * @tparam T Type of the values held in the stack pool, an arithmetic type.
+   * @tparam N Type of "pointers" to stack nodes.
+   * @param tp Thread pool running the computation.
+   * @param path
+   * @param pool
+   * @param max_stacks Upper bound on the number of stacks.
+   * @return std::vector<N>
+   */
+  template <typename T, typename N>
+  std::vector<N> ingest_text(
+      work_stealing_pool& tp,
+      const std::string& path,
+      stack_pool<T, N>& pool,
+      std::size_t max_stacks = detail::default_max_stacks) {
+    static_assert(std::is_arithmetic<T>::value,
+                  "The values must be numbers.");
+    const mapped_file file{path};
+    const char* data = file.data();
+    const std::size_t size = file.size();
+
+    // a part starts after the first newline following size * k / parts
+    const std::size_t n_parts =
+        std::max<std::size_t>(1, std::min(tp.size(), size >> 20));
+    std::vector<std::size_t> bounds{0};
+    for (std::size_t k = 1; k < n_parts; ++k) {
+      std::size_t p = std::max(std::max<std::size_t>(size / n_parts * k, 1),
+                               bounds.back());
+      const void* nl = p < size ? std::memchr(data + p - 1, '\n', size - p + 1)
+                                : nullptr;
+      p = nl ? std::size_t(static_cast<const char*>(nl) - data) + 1 : size;
+      bounds.push_back(p);
+    }
+    bounds.push_back(size);
+
+    std::vector<detail::ingested_part<T>> parts(n_parts);
+    tp.parallel_for(
+        n_parts,
+        [&](std::size_t k) {
+          auto& out = parts[k];
+          const char* p = data + bounds[k];
+          const char* last = data + bounds[k + 1];
+          while (p != last) {
+            if (*p == '\n' || *p == '\r') {
+              ++p;
+              continue;
+            }
+            const char* line = p;
+            std::uint32_t id;
+            T value;
+            p = detail::parse_number(p, last, id);
+            if (p && p != last && *p == '\t')
+              p = detail::parse_number(p + 1, last, value);
+            else
+              p = nullptr;
+            if (p && p != last && *p == '\r')
+              ++p;
+            if (!p || (p != last && *p != '\n'))
+              throw std::runtime_error("Malformed line at byte " +
+                                       std::to_string(line - data) + ".");
+            if (id >= max_stacks)
+              throw std::runtime_error("Stack id too large at byte " +
+                                       std::to_string(line - data) + ".");
+            out.pairs.emplace_back(id, value);
+            out.n_stacks = std::max<std::size_t>(out.n_stacks, id + 1ull);
+          }
+        },
+        1);
+    return detail::build_parts(tp, parts, pool);
+  }
+
+  /**
+   * @brief Read the binary file `path` into new stacks of `pool`, and return
+   * the head of stack `i` at index `i`.
+   *
+   * The file is a sequence of records of `4 + sizeof(T)` bytes, without
+   * padding: the stack id as a `std::uint32_t`, then the value, both in the
+   * native byte order. Otherwise this works as ingest_text.
+   *
+   * This function throws std::system_error if the file cannot be read,
+   * std::runtime_error if its size is not a multiple of the size of a record
+   * or if some id is not smaller than `max_stacks`, and std::length_error if
+   * the nodes are not addressable by N. The pool is not modified in these
+   * cases.
+   *
+   * @tparam T Type of the values held in the stack pool, trivially copyable.
+   * @tparam N Type of "pointers" to stack nodes.
+   * @param tp Thread pool running the computation.
+   * @param path
+   * @param pool
+   * @param max_stacks Upper bound on the number of stacks.
+   * @return std::vector<N>
+   */
+  template <typename T, typename N>
+  std::vector<N> ingest_binary(
+      work_stealing_pool& tp,
+      const std::string& path,
+      stack_pool<T, N>& pool,
+      std::size_t max_stacks = detail::default_max_stacks) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "The values must be trivially copyable.");
+    const std::size_t record = sizeof(std::uint32_t) + sizeof(T);
+    const mapped_file file{path};
+    if (file.size() % record != 0)
+      throw std::runtime_error("The size of " + path +
+                               " is not a multiple of the record size.");
+    const std::size_t n = file.size() / record;
+
+    const std::size_t n_parts =
+        std::max<std::size_t>(1, std::min(tp.size(), n >> 16));
+    std::vector<detail::ingested_part<T>> parts(n_parts);
+    tp.parallel_for(
+        n_parts,
+        [&](std::size_t k) {
+          auto& out = parts[k];
+          const std::size_t first = n * k / n_parts;
+          const std::size_t last = n * (k + 1) / n_parts;
+          out.pairs.resize(last - first);
+          const char* p = file.data() + first * record;
+          for (auto& pair : out.pairs) {
+            std::memcpy(&pair.first, p, sizeof(std::uint32_t));
+            std::memcpy(&pair.second, p + sizeof(std::uint32_t), sizeof(T));
+            p += record;
+            if (pair.first >= max_stacks)
+              throw std::runtime_error(
+                  "Stack id too large in record " +
+                  std::to_string(std::size_t(&pair - out.pairs.data()) +
+                                 first) +
+                  ".");
+            out.n_stacks = std::max<std::size_t>(out.n_stacks,
+                                                 pair.first + 1ull);
+          }
+        },
+        1);
+    return detail::build_parts(tp, parts, pool);
+  }
+}  // namespace stack_utils
@@ -0,0 +1,594 @@
+#pragma once
+
+#include "stack_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Journal file format, in the native byte order. The file is a sequence of
+// frames, each one written by a single group commit:
+//
+//   frame  := magic:u32 n_bytes:u32 checksum:u32 record*
+//   record := stream:u32 op:u8 lsn:u64 slot:u64 value_size:u32 value
+//
+// n_bytes and checksum (FNV-1a) cover the records of the frame. A frame
+// which is incomplete or whose checksum is wrong (i.e. a write torn by a
+// crash) ends the journal.
+
+namespace stack_utils {
+  namespace detail {
+    constexpr std::uint32_t journal_magic = 0x314a5350;  // "PSJ1"
+    constexpr std::size_t frame_header = 3 * sizeof(std::uint32_t);
+    constexpr std::size_t record_header = 2 * sizeof(std::uint32_t) +
+                                          sizeof(std::uint8_t) +
+                                          2 * sizeof(std::uint64_t);
+
+    inline std::uint32_t fnv1a(const char* p, std::size_t n) noexcept {
+      std::uint32_t h = 2166136261u;
+      for (std::size_t i = 0; i < n; ++i)
+        h = (h ^ static_cast<unsigned char>(p[i])) * 16777619u;
+      return h;
+    }
+
+    template <typename X>
+    const char* get(const char* p, X& x) noexcept {
+      std::memcpy(&x, p, sizeof(X));
+      return p + sizeof(X);
+    }
+  }  // namespace detail
+
+  /**
+   * @brief A record of the journal, as passed to the callback of
+   * read_journal. `value` points to `value_size` bytes, valid during the
+   * call.
+   */
+  struct journal_record {
+    enum op_code : std::uint8_t { push, pop, free_stack };
+
+    std::uint32_t stream;
+    std::uint8_t op;
+    std::uint64_t lsn;
+    std::uint64_t slot;
+    std::uint32_t value_size;
+    const char* value;
+  };
+
+  /**
+   * @brief Call `f(record)` on each record of the journal in `is`, in the
+   * order in which they were committed, and return the length of the valid
+   * part of the journal (in bytes).
+   *
+   * Reading stops at the end of the stream or at the first torn frame.
+   * This function throws std::runtime_error if a frame with a valid
+   * checksum holds malformed records.
+   *
+   * @tparam F A callable object taking a `const journal_record&`.
+   * @param is A binary input stream.
+   * @param f
+   * @return std::uint64_t
+   */
+  template <typename F>
+  std::uint64_t read_journal(std::istream& is, F f) {
+    std::uint64_t valid = 0;
+    std::vector<char> frame;
+    for (;;) {
+      std::uint32_t header[3];
+      if (!is.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+          header[0] != detail::journal_magic)
+        return valid;
+      frame.resize(header[1]);
+      if (!is.read(frame.data(), header[1]) ||
+          detail::fnv1a(frame.data(), frame.size()) != header[2])
+        return valid;
+
+      const char* p = frame.data();
+      const char* last = p + frame.size();
+      while (p != last) {
+        journal_record r;
+        if (std::size_t(last - p) < detail::record_header)
+          throw std::runtime_error("Malformed record in the journal.");
+        p = detail::get(p, r.stream);
+        p = detail::get(p, r.op);
+        p = detail::get(p, r.lsn);
+        p = detail::get(p, r.slot);
+        p = detail::get(p, r.value_size);
+        if (std::size_t(last - p) < r.value_size)
+          throw std::runtime_error("Malformed record in the journal.");
+        r.value = p;
+        p += r.value_size;
+        f(r);
+      }
+      valid += detail::frame_header + frame.size();
+    }
+  }
+}  // namespace stack_utils
+
+/**
+ * @brief Options of a stack_journal.
+ */
+struct journal_options {
+  // a background thread commits the buffered records with this period. If
+  // zero, records are committed only by stack_journal::commit
+  std::chrono::microseconds commit_interval{1000};
+  // whether each commit waits for the data to reach the disk (fdatasync)
+  bool sync = true;
+};
+
+/**
+ * @brief An append-only file of operations on stack pools (see
+ * journaled_stack_pool), written with group commit.
+ *
+ * Each pool appends its records to its own buffer, which holds a mutex
+ * contended only while a commit collects it. A commit gathers the buffers of
+ * all the pools into a single frame, written with a single `write` and then
+ * synced if required. Commits are made periodically by a background thread
+ * and by commit(), which returns when everything appended before the call is
+ * written (and synced). Records which are not committed are lost by a crash.
+ *
+ * When a journal is opened, a frame torn by a crash at the end of the file
+ * is truncated, so that new frames are readable. The constructor throws
+ * std::system_error if the file cannot be opened.
+ *
+ * A failed commit poisons the journal: the frame which could not be written
+ * is kept in memory, nothing is written anymore (a torn frame would make all
+ * the following ones unreadable), and every later append and commit throws.
+ */
+class stack_journal {
+ public:
+  class writer {
+    friend class stack_journal;
+    std::mutex m;
+    std::vector<char> buffer;
+    // the buffer being committed, swapped with `buffer`
+    std::vector<char> committing;
+    const std::atomic<bool>* poisoned;
+
+    explicit writer(const std::atomic<bool>* p) : poisoned{p} {}
+
+   public:
+    /**
+     * @brief Append a record, see journal_record.
+     *
+     * This throws std::runtime_error if the journal is poisoned by a failed
+     * commit, and nothing is appended in this case.
+     */
+    void append(std::uint32_t stream,
+                std::uint8_t op,
+                std::uint64_t lsn,
+                std::uint64_t slot,
+                const void* value,
+                std::uint32_t value_size) {
+      char header[stack_utils::detail::record_header];
+      char* p = header;
+      auto put = [&p](const void* x, std::size_t n) {
+        std::memcpy(p, x, n);
+        p += n;
+      };
+      put(&stream, sizeof(stream));
+      put(&op, sizeof(op));
+      put(&lsn, sizeof(lsn));
+      put(&slot, sizeof(slot));
+      put(&value_size, sizeof(value_size));
+      if (poisoned->load(std::memory_order_acquire))
+        throw std::runtime_error(
+            "The journal is poisoned by a failed commit.");
+      std::lock_guard<std::mutex> lock{m};
+      // allocate first, so that a record is never appended in part
+      buffer.reserve(buffer.size() + std::size_t(p - header) + value_size);
+      buffer.insert(buffer.end(), header, p);
+      buffer.insert(buffer.end(), static_cast<const char*>(value),
+                    static_cast<const char*>(value) + value_size);
+    }
+  };
+
+ private:
+  int fd;
+  journal_options options;
+
+  std::mutex writers_mutex;
+  std::vector<std::unique_ptr<writer>> writers;
+
+  std::mutex commit_mutex;
+  // after a failed commit, the frame which could not be written
+  std::vector<char> frame;
+  // the error of the first failed commit, which poisons the journal
+  std::exception_ptr error;
+  std::atomic<bool> poisoned;
+  std::uint64_t n_commits;
+
+  std::mutex stop_mutex;
+  std::condition_variable stop_cv;
+  bool stopping;
+  std::thread committer;
+
+  void write_all(const char* p, std::size_t n) {
+    while (n > 0) {
+      const ssize_t w = ::write(fd, p, n);
+      if (w < 0) {
+        if (errno == EINTR)
+          continue;
+        throw std::system_error(errno, std::generic_category(),
+                                "journal write");
+      }
+      p += w;
+      n -= std::size_t(w);
+    }
+  }
+
+  void do_commit() {
+    if (error)
+      std::rethrow_exception(error);
+    try {
+      write_frame();
+    } catch (...) {
+      error = std::current_exception();
+      poisoned.store(true, std::memory_order_release);
+      throw;
+    }
+  }
+
+  void write_frame() {
+    frame.resize(stack_utils::detail::frame_header);
+    {
+      std::lock_guard<std::mutex> lock{writers_mutex};
+      for (auto& w : writers) {
+        {
+          std::lock_guard<std::mutex> wl{w->m};
+          std::swap(w->buffer, w->committing);
+        }
+        frame.insert(frame.end(), w->committing.begin(), w->committing.end());
+        w->committing.clear();
+      }
+    }
+    const std::size_t n = frame.size() - stack_utils::detail::frame_header;
+    if (n == 0)
+      return;
+    // n_bytes cannot hold the size of the frame, which is kept unwritten
+    if (n > std::numeric_limits<std::uint32_t>::max())
+      throw std::length_error("Too many records for a single commit.");
+    const std::uint32_t header[3] = {
+        stack_utils::detail::journal_magic, std::uint32_t(n),
+        stack_utils::detail::fnv1a(
+            frame.data() + stack_utils::detail::frame_header, n)};
+    std::memcpy(frame.data(), header, sizeof(header));
+    write_all(frame.data(), frame.size());
+    if (options.sync && ::fdatasync(fd) != 0)
+      throw std::system_error(errno, std::generic_category(),
+                              "journal fdatasync");
+    ++n_commits;
+  }
+
+  void commit_periodically() {
+    std::unique_lock<std::mutex> lock{stop_mutex};
+    while (!stopping) {
+      stop_cv.wait_for(lock, options.commit_interval);
+      lock.unlock();
+      {
+        std::lock_guard<std::mutex> c{commit_mutex};
+        try {
+          do_commit();
+        } catch (...) {
+          // the journal is poisoned, reported by commit()
+          return;
+        }
+      }
+      lock.lock();
+    }
+  }
+
+ public:
+  explicit stack_journal(const std::string& path, journal_options o = {})
+      : fd{-1},
+        options{o},
+        poisoned{false},
+        n_commits{0},
+        stopping{false} {
+    std::uint64_t valid = 0;
+    {
+      std::ifstream in{path, std::ios::binary};
+      if (in)
+        valid = stack_utils::read_journal(in, [](const auto&) {});
+    }
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+      throw std::system_error(errno, std::generic_category(), path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        (std::uint64_t(st.st_size) > valid &&
+         ::ftruncate(fd, off_t(valid)) != 0)) {
+      const int e = errno;
+      ::close(fd);
+      throw std::system_error(e, std::generic_category(), path);
+    }
+    if (options.commit_interval.count() > 0)
+      committer = std::thread{[this]() { commit_periodically(); }};
+  }
+
+  stack_journal(const stack_journal&) = delete;
+  stack_journal& operator=(const stack_journal&) = delete;
+
+  /**
+   * @brief Commit the remaining records, and close the file. Errors are
+   * ignored, call commit() first to see them.
+   */
+  ~stack_journal() {
+    if (committer.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock{stop_mutex};
+        stopping = true;
+      }
+      stop_cv.notify_one();
+      committer.join();
+    }
+    try {
+      std::lock_guard<std::mutex> c{commit_mutex};
+      do_commit();
+    } catch (...) {
+    }
+    ::close(fd);
+  }
+
+  /**
+   * @brief Return a new buffer for the records of a pool. It is owned by the
+   * journal, and valid as long as the journal.
+   */
+  writer* add_writer() {
+    std::lock_guard<std::mutex> lock{writers_mutex};
+    writers.push_back(std::unique_ptr<writer>(new writer{&poisoned}));
+    return writers.back().get();
+  }
+
+  /**
+   * @brief Write (and sync, if required) all the records appended so far,
+   * together with those of the other pools.
+   *
+   * This throws std::system_error if the write fails, or if the journal is
+   * poisoned by a commit which failed before (in the background too): the
+   * exception of that commit is thrown again.
+   */
+  void commit() {
+    std::lock_guard<std::mutex> c{commit_mutex};
+    do_commit();
+  }
+
+  /**
+   * @brief Check whether a commit failed, see commit().
+   */
+  bool poisoned_by_error() const noexcept {
+    return poisoned.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Return the number of frames written.
+   */
+  std::uint64_t commits() {
+    std::lock_guard<std::mutex> c{commit_mutex};
+    return n_commits;
+  }
+};
+
+/**
+ * @brief A stack_pool whose push, pop and free_stack are recorded in a
+ * stack_journal, so that it can be recovered after a crash from a snapshot
+ * and the journal.
+ *
+ * Stacks are designated by slots, i.e. indices in a table of heads held by
+ * the pool, so that the heads are recovered too. Each operation gets a log
+ * sequence number (LSN); a snapshot records the last one, and recover()
+ * replays the records of the journal which follow it. Several pools (e.g.
+ * one per thread) can share a journal, each with its own stream id.
+ *
+ * The pool is not thread safe, as stack_pool. T must be trivially copyable.
+ *
+ * @tparam T Type of the values to be held in the stacks of this pool.
+ * @tparam N Type using to designate the head of a stack.
+ */
+template <typename T, typename N = std::size_t>
+class journaled_stack_pool {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "The values must be trivially copyable.");
+
+  using stack_type = N;
+  using op_code = stack_utils::journal_record::op_code;
+
+  stack_pool<T, N> pool;
+  std::vector<stack_type> heads;
+  stack_journal::writer* journal;
+  std::uint32_t stream_id;
+  std::uint64_t last_lsn;
+
+  // "psjsnap1"
+  static constexpr std::uint64_t snapshot_magic = 0x3170616e736a7370;
+
+  stack_type& slot_head(std::size_t slot) {
+    if (slot >= heads.size())
+      heads.resize(slot + 1, pool.end());
+    return heads[slot];
+  }
+
+  // apply an operation, without recording it. This does not throw after
+  // prepare(op, slot)
+  void apply(op_code op, std::size_t slot, const T* value) {
+    stack_type& h = slot_head(slot);
+    if (op == op_code::push)
+      h = pool.push(*value, h);
+    else if (op == op_code::pop)
+      h = pool.pop(h);
+    else
+      h = pool.free_stack(h);
+  }
+
+  // make room for the slot, and check that the operation can be applied
+  void prepare(op_code op, std::size_t slot) {
+    if (pool.empty(slot_head(slot)) && op == op_code::pop)
+      throw std::out_of_range("Cannot pop an empty stack.");
+  }
+
+  // record an operation before it is applied, so that the pool never holds
+  // a change which is not in the journal
+  void record(op_code op, std::size_t slot, const T* value) {
+    journal->append(stream_id, op, last_lsn + 1, slot, value,
+                    value ? sizeof(T) : 0);
+    ++last_lsn;
+  }
+
+ public:
+  /**
+   * @brief Construct an empty pool, recorded in `j` as the stream `stream`.
+   *
+   * @param j
+   * @param stream
+   */
+  journaled_stack_pool(stack_journal& j, std::uint32_t stream)
+      : journal{j.add_writer()}, stream_id{stream}, last_lsn{0} {}
+
+  /**
+   * @brief Recover the pool recorded as the stream `stream`: load the
+   * snapshot (if any), then replay the records of the journal file which
+   * follow it. The recovered pool is recorded in `j`, which must be open
+   * already. To go on appending to the same file, open `j` on
+   * `journal_path` before this call: the torn frame at the end of the file
+   * (if any) is truncated, and the records read here are not written again.
+   *
+   * This throws std::runtime_error if the snapshot is not valid or if a
+   * record of the stream has an unknown operation, and the exceptions of
+   * read_journal.
+   *
+   * @param j
+   * @param stream
+   * @param journal_path
+   * @param snapshot A stream written by snapshot(), or nullptr.
+   * @return journaled_stack_pool
+   */
+  static journaled_stack_pool recover(stack_journal& j,
+                                      std::uint32_t stream,
+                                      const std::string& journal_path,
+                                      std::istream* snapshot = nullptr) {
+    journaled_stack_pool p{j, stream};
+    if (snapshot) {
+      std::uint64_t header[3];
+      if (!snapshot->read(reinterpret_cast<char*>(header), sizeof(header)) ||
+          header[0] != snapshot_magic)
+        throw std::runtime_error("Not a journaled_stack_pool snapshot.");
+      p.last_lsn = header[1];
+      // the heads are read chunk by chunk, rather than trusting the count in
+      // the header, so that a corrupted count fails on the truncated stream
+      const std::uint64_t chunk = 1 << 16;
+      while (p.heads.size() < header[2]) {
+        const std::size_t first = p.heads.size();
+        const std::size_t n =
+            std::size_t(std::min(chunk, header[2] - first));
+        p.heads.resize(first + n);
+        if (!snapshot->read(reinterpret_cast<char*>(p.heads.data() + first),
+                            std::streamsize(n * sizeof(stack_type))))
+          throw std::runtime_error("The snapshot is truncated.");
+      }
+      p.pool = stack_pool<T, N>::load(*snapshot);
+    }
+
+    std::ifstream in{journal_path, std::ios::binary};
+    stack_utils::read_journal(in, [&p, stream](const auto& r) {
+      if (r.stream != stream || r.lsn <= p.last_lsn)
+        return;
+      if (r.op > op_code::free_stack)
+        throw std::runtime_error("Unknown operation in the journal.");
+      T value;
+      if (r.op == op_code::push) {
+        if (r.value_size != sizeof(T))
+          throw std::runtime_error("Malformed record in the journal.");
+        std::memcpy(&value, r.value, sizeof(T));
+      }
+      p.apply(op_code(r.op), std::size_t(r.slot),
+              r.op == op_code::push ? &value : nullptr);
+      p.last_lsn = r.lsn;
+    });
+    return p;
+  }
+
+  /**
+   * @brief Write the pool, its heads and its last LSN. The journal can be
+   * truncated once the snapshot is safely stored, if no other stream uses
+   * it.
+   *
+   * @param os
+   */
+  void snapshot(std::ostream& os) const {
+    const std::uint64_t header[3] = {snapshot_magic, last_lsn, heads.size()};
+    os.write(reinterpret_cast<const char*>(header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(heads.data()),
+             std::streamsize(heads.size() * sizeof(stack_type)));
+    pool.save(os);
+  }
+
+  /**
+   * @brief Push a value to the stack in `slot`, creating it if needed.
+   */
+  void push(std::size_t slot, const T& value) {
+    prepare(op_code::push, slot);
+    record(op_code::push, slot, &value);
+    apply(op_code::push, slot, &value);
+  }
+
+  /**
+   * @brief Pop the head of the stack in `slot`. See stack_pool::pop.
+   */
+  void pop(std::size_t slot) {
+    prepare(op_code::pop, slot);
+    record(op_code::pop, slot, nullptr);
+    apply(op_code::pop, slot, nullptr);
+  }
+
+  /**
+   * @brief Empty the stack in `slot`. See stack_pool::free_stack.
+   */
+  void free_stack(std::size_t slot) {
+    prepare(op_code::free_stack, slot);
+    record(op_code::free_stack, slot, nullptr);
+    apply(op_code::free_stack, slot, nullptr);
+  }
+
+  /**
+   * @brief Return the head of the stack in `slot`, end() if it is empty or
+   * was never used.
+   */
+  stack_type head(std::size_t slot) const noexcept {
+    return slot < heads.size() ? heads[slot] : pool.end();
+  }
+
+  /**
+   * @brief Return the number of slots used so far.
+   */
+  std::size_t slots() const noexcept { return heads.size(); }
+
+  /**
+   * @brief Return the LSN of the last operation.
+   */
+  std::uint64_t lsn() const noexcept { return last_lsn; }
+
+  /**
+   * @brief Return the underlying pool, to read the stacks.
+   */
+  const stack_pool<T, N>& underlying() const noexcept { return pool; }
+};
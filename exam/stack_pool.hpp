@@ -1,5 +1,12 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 template <typename stack_type, typename T, typename P>
@@ -27,12 +34,13 @@ class stack_iterator {
       *(*this);
     }
   }
-  stack_iterator(stack_iterator& other)
-      // delegating constructor
-      : stack_iterator(other.current_head, other.pool) {}
-  stack_iterator(stack_iterator&& other)
-      : stack_iterator(other.current_head, other.pool) {
-    other.current_head = other.pool->end();
+  // the head of `other` was already checked, so copies do not check it again
+  stack_iterator(stack_iterator& other) noexcept
+      : current_head{other.current_head}, pool{other.pool} {}
+  stack_iterator(stack_iterator&& other) noexcept
+      : current_head{other.current_head}, pool{other.pool} {
+    // `other` may have been moved from already, the end of any pool is 0
+    other.current_head = stack_type(0);
     other.pool = nullptr;
   }
 
@@ -46,7 +54,7 @@ class stack_iterator {
     current_head = std::move(other.current_head);
     pool = other.pool;
 
-    other.current_head = other.pool->end();
+    other.current_head = stack_type(0);
     other.pool = nullptr;
 
     return *this;
@@ -65,7 +73,8 @@ class stack_iterator {
   // this throws an exception if current_head does not have a next (i.e. it is
   // pool.end)
   stack_iterator& operator++() {
-    current_head = pool->next(current_head);
+    // read-only access, which is never recorded in the undo log of the pool
+    current_head = static_cast<const P*>(pool)->next(current_head);
     return *this;
   }
   stack_iterator operator++(int) {
@@ -86,6 +95,112 @@ class stack_iterator {
   }
 };
 
+/**
+ * @brief Marks the end of any stack when using unchecked_stack_iterator.
+ */
+struct stack_sentinel {};
+
+/**
+ * @brief An iterator over a stack which does no check at all.
+ *
+ * The iterator holds a pointer to the nodes of the pool instead of a pointer
+ * to the pool, and follows the `next` indices without bounds checking,
+ * therefore a loop over a stack compiles down to a plain index loop. The
+ * head and all the nodes below it must be valid, and the pool must not grow
+ * while the iterator is in use (it would invalidate the pointer to the
+ * nodes).
+ *
+ * The end of any stack is given by stack_sentinel.
+ *
+ * @tparam stack_type Type of "pointers" to stack nodes.
+ * @tparam T Type of the values held in the stack pool (possibly const).
+ * @tparam Node Type of the nodes of the stack pool (possibly const).
+ */
+template <typename stack_type, typename T, typename Node>
+class unchecked_stack_iterator {
+  Node* nodes;
+  stack_type current_head;
+
+ public:
+  using value_type = typename std::remove_const<T>::type;
+  using reference = T&;
+  using pointer = T*;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  unchecked_stack_iterator() noexcept : nodes{nullptr}, current_head{0} {}
+  unchecked_stack_iterator(Node* pool_nodes, stack_type head) noexcept
+      : nodes{pool_nodes}, current_head{head} {}
+
+  T& operator*() const noexcept { return nodes[current_head - 1].value; }
+  T* operator->() const noexcept { return &nodes[current_head - 1].value; }
+
+  unchecked_stack_iterator& operator++() noexcept {
+    current_head = nodes[current_head - 1].next;
+    return *this;
+  }
+  unchecked_stack_iterator operator++(int) noexcept {
+    auto tmp = *this;
+    ++(*this);
+    return tmp;
+  }
+
+  stack_type ptr_to_stack() const noexcept { return current_head; }
+
+  friend bool operator==(const unchecked_stack_iterator& a,
+                         const unchecked_stack_iterator& b) noexcept {
+    return a.current_head == b.current_head;
+  }
+  friend bool operator!=(const unchecked_stack_iterator& a,
+                         const unchecked_stack_iterator& b) noexcept {
+    return !(a == b);
+  }
+  friend bool operator==(const unchecked_stack_iterator& a,
+                         stack_sentinel) noexcept {
+    return a.current_head == stack_type(0);
+  }
+  friend bool operator!=(const unchecked_stack_iterator& a,
+                         stack_sentinel) noexcept {
+    return a.current_head != stack_type(0);
+  }
+  friend bool operator==(stack_sentinel s,
+                         const unchecked_stack_iterator& a) noexcept {
+    return a == s;
+  }
+  friend bool operator!=(stack_sentinel s,
+                         const unchecked_stack_iterator& a) noexcept {
+    return a != s;
+  }
+};
+
+/**
+ * @brief A snapshot of the state of a stack_pool, see stack_pool::stats.
+ */
+struct stack_pool_stats {
+  // events counted while stack_pool::count_events was enabled
+  bool counts_events;
+  std::uint64_t pushes;
+  std::uint64_t pops;
+  std::uint64_t free_stacks;
+  // reallocations of the nodes caused by push
+  std::uint64_t reallocations;
+
+  // nodes allocated, belonging to some stack, and free
+  std::size_t nodes;
+  std::size_t live_nodes;
+  std::size_t free_nodes;
+  // the longest sequence of adjacent free nodes
+  std::size_t largest_free_run;
+  // 1 - largest_free_run / free_nodes: 0 if the free nodes are contiguous,
+  // close to 1 if they are scattered among the live ones
+  double fragmentation;
+
+  // memory held by the pool (nodes, bitmap, undo logs), and memory of the
+  // live nodes. Memory owned by the values (e.g. strings) is not included
+  std::size_t bytes_reserved;
+  std::size_t bytes_used;
+};
+
 /**
  * @brief A pool which can handle multiple stacks.
  *
@@ -120,31 +235,159 @@ class stack_pool {
 
   stack_type free_nodes;
 
+  // one bit per node, set if the node belongs to some stack. Maintained only
+  // if liveness_tracked.
+  std::vector<std::uint64_t> live_nodes;
+  bool liveness_tracked;
+
+  // first bytes written by save(): "pspool1" followed by a null byte
+  static constexpr std::uint64_t saved_magic = 0x00316c6f6f707370;
+
+  // the state of the pool when a checkpoint was taken, and the size of the
+  // undo logs at that moment
+  struct checkpoint_t {
+    size_type links;
+    size_type flips;
+    size_type size;
+    stack_type free_nodes;
+    stack_type retired;
+    // false if live_nodes was recomputed after the checkpoint, and cannot be
+    // restored from undo_flips
+    bool bitmap_valid;
+  };
+  struct link_change {
+    stack_type node;
+    stack_type next;
+  };
+
+  std::vector<checkpoint_t> checkpoints;
+  // former `next` of the modified nodes, in order of modification
+  std::vector<link_change> undo_links;
+  // nodes whose liveness bit was flipped
+  std::vector<stack_type> undo_flips;
+  // nodes freed while a checkpoint is active. They are not recycled until
+  // the outermost checkpoint is committed, so that a rollback finds their
+  // values untouched
+  stack_type retired;
+
+  // see count_events
+  bool events_counted;
+  struct {
+    std::uint64_t pushes = 0;
+    std::uint64_t pops = 0;
+    std::uint64_t free_stacks = 0;
+    std::uint64_t reallocations = 0;
+  } events;
+
+  void count(std::uint64_t& event) noexcept {
+    if (events_counted)
+      ++event;
+  }
+
   node_t& node(stack_type x) { return pool.at(x - 1); }
   const node_t& node(stack_type x) const { return pool.at(x - 1); }
 
+  bool checkpointing() const noexcept { return !checkpoints.empty(); }
+
+  // whether a change to the link of x must be recorded in the undo log.
+  // Nodes allocated after the last checkpoint are dropped by any rollback,
+  // therefore their links are never recorded
+  bool logged(stack_type x) const noexcept {
+    return checkpointing() && x <= checkpoints.back().size;
+  }
+
+  // all the writes to `next` go through here, so that they can be undone
+  void set_next(stack_type x, stack_type n) {
+    node_t& nd = node(x);
+    if (logged(x))
+      undo_links.push_back(link_change{x, nd.next});
+    nd.next = n;
+  }
+
+  // the stack which receives the nodes being freed
+  stack_type& free_list() noexcept {
+    return checkpointing() ? retired : free_nodes;
+  }
+
+  void flip(stack_type x) noexcept {
+    live_nodes[(x - 1) / 64] ^= std::uint64_t(1) << ((x - 1) % 64);
+  }
+  void mark_live(stack_type x) {
+    if (liveness_tracked) {
+      live_nodes[(x - 1) / 64] |= std::uint64_t(1) << ((x - 1) % 64);
+      if (checkpointing())
+        undo_flips.push_back(x);
+    }
+  }
+  void mark_free(stack_type x) {
+    if (liveness_tracked) {
+      live_nodes[(x - 1) / 64] &= ~(std::uint64_t(1) << ((x - 1) % 64));
+      if (checkpointing())
+        undo_flips.push_back(x);
+    }
+  }
+
+  // all the nodes are live, except those in the stack of free nodes and in
+  // the stack of retired nodes
+  std::vector<std::uint64_t> compute_live_nodes() const {
+    std::vector<std::uint64_t> bits(pool.size() / 64, ~std::uint64_t(0));
+    if (pool.size() % 64 != 0)
+      bits.push_back((std::uint64_t(1) << (pool.size() % 64)) - 1);
+    for (stack_type f : {free_nodes, retired})
+      for (stack_type x = f; x != end(); x = pool[x - 1].next)
+        bits[(x - 1) / 64] &= ~(std::uint64_t(1) << ((x - 1) % 64));
+    return bits;
+  }
+
+  // call f(x) for each bit x set in the given bitmap, in increasing order
+  template <typename F>
+  static void for_each_bit(const std::vector<std::uint64_t>& bits, F f) {
+    for (std::size_t w = 0; w < bits.size(); ++w) {
+      std::uint64_t word = bits[w];
+      const std::size_t first = w * 64;
+      if (word == ~std::uint64_t(0)) {
+        // all live, a plain loop which can be vectorized
+        for (std::size_t i = 0; i < 64; ++i)
+          f(first + i);
+        continue;
+      }
+      while (word != 0) {
+        f(first + __builtin_ctzll(word));
+        // clear the lowest bit set
+        word &= word - 1;
+      }
+    }
+  }
+
   template <typename X>
   // universal reference
   // this is marked as noexcept because it is not possible to get an exception,
   // since the allocation of a new free node is managed internally, and head
   // is just used as the new "next node" of the free node in which the new
-  // value is placed.
+  // value is placed. A failed allocation (of the pool or of the undo log)
+  // terminates the program.
   stack_type _push(X&& val, stack_type head) noexcept {
     // if needed, we allocate a new free node
     if (free_nodes == end()) {
-      node_t n = node_t();
-      n.next = end();
-      pool.push_back(std::move(n));
+      if (pool.size() == pool.capacity())
+        count(events.reallocations);
+      // value-initialized in place: the value is default constructed, and
+      // next is end()
+      pool.emplace_back();
       free_nodes = pool.size();
+      if (liveness_tracked && live_nodes.size() * 64 < pool.size())
+        live_nodes.push_back(0);
     }
 
     stack_type new_head = free_nodes;
 
     // we use the next free node as the new head of the stack free_nodes
-    free_nodes = next(free_nodes);
+    free_nodes = node(free_nodes).next;
 
-    next(new_head) = head;
+    set_next(new_head, head);
     value(new_head) = std::forward<X>(val);
+    mark_live(new_head);
+    count(events.pushes);
 
     return new_head;
   }
@@ -154,14 +397,24 @@ class stack_pool {
    * @brief Construct a new stack pool object having initial capacity 0.
    *
    */
-  stack_pool() noexcept : free_nodes{end()} {};
+  stack_pool() noexcept
+      : free_nodes{end()},
+        liveness_tracked{false},
+        retired{end()},
+        events_counted{false} {};
 
   /**
    * @brief Construct a new stack pool object having a given initial capacity.
    *
    * @param n The initial capacity of the pool.
    */
-  explicit stack_pool(size_type n) : free_nodes{end()} { reserve(n); }
+  explicit stack_pool(size_type n)
+      : free_nodes{end()},
+        liveness_tracked{false},
+        retired{end()},
+        events_counted{false} {
+    reserve(n);
+  }
 
   using iterator = stack_iterator<stack_type, T, stack_pool>;
   using const_iterator = stack_iterator<stack_type, const T, const stack_pool>;
@@ -179,6 +432,55 @@ class stack_pool {
     return const_iterator(end(), this);
   }
 
+  using unchecked_iterator = unchecked_stack_iterator<stack_type, T, node_t>;
+  using const_unchecked_iterator =
+      unchecked_stack_iterator<stack_type, const T, const node_t>;
+
+  /**
+   * @brief Return an iterator to the top of the given stack which does no
+   * check at all (see unchecked_stack_iterator). The iterator is invalidated
+   * when the pool grows.
+   *
+   * @param x Head of the stack, which must be valid.
+   * @return unchecked_iterator
+   */
+  unchecked_iterator unchecked_begin(stack_type x) noexcept {
+    return unchecked_iterator(pool.data(), x);
+  }
+  const_unchecked_iterator unchecked_begin(stack_type x) const noexcept {
+    return const_unchecked_iterator(pool.data(), x);
+  }
+  stack_sentinel unchecked_end(stack_type) const noexcept { return {}; }
+
+  /**
+   * @brief Call `f` on each value of the given stack, from top to bottom.
+   *
+   * Like unchecked_begin, nothing is checked: the head and all the nodes
+   * below it must be valid, and `f` must not modify the pool.
+   *
+   * @tparam F A callable object taking a `T&`.
+   * @param x Head of the stack.
+   * @param f
+   */
+  template <typename F>
+  void for_each(stack_type x, F f) {
+    node_t* nodes = pool.data();
+    while (x != end()) {
+      node_t& n = nodes[x - 1];
+      f(n.value);
+      x = n.next;
+    }
+  }
+  template <typename F>
+  void for_each(stack_type x, F f) const {
+    const node_t* nodes = pool.data();
+    while (x != end()) {
+      const node_t& n = nodes[x - 1];
+      f(n.value);
+      x = n.next;
+    }
+  }
+
   /**
    * @brief "Allocate" a new stack in this pool. Returns the head of the new
    * stack.
@@ -197,7 +499,11 @@ class stack_pool {
    *
    * @param n The advised new size of the stack.
    */
-  void reserve(size_type n) { pool.reserve(n); }
+  void reserve(size_type n) {
+    pool.reserve(n);
+    if (liveness_tracked)
+      live_nodes.reserve((n + 63) / 64);
+  }
 
   /**
    * @brief Return the capacity of the pool (i.e. the total number of stack
@@ -250,10 +556,20 @@ class stack_pool {
    * This method throws an exception if the given head is not a invalid index
    * in the pool.
    *
+   * While a checkpoint is active, the current value is recorded in the undo
+   * log, since it may be modified through the returned reference (unless the
+   * node was allocated after the checkpoint). Use a const pool to follow the
+   * stacks without recording anything.
+   *
    * @param x
    * @return stack_type&
    */
-  stack_type& next(stack_type x) { return node(x).next; }
+  stack_type& next(stack_type x) {
+    node_t& nd = node(x);
+    if (logged(x))
+      undo_links.push_back(link_change{x, nd.next});
+    return nd.next;
+  }
   /**
    * @brief Return the next node in the given stack.
    *
@@ -265,6 +581,28 @@ class stack_pool {
    */
   const stack_type& next(stack_type x) const { return node(x).next; }
 
+  /**
+   * @brief Hint the processor that the given node is going to be accessed
+   * soon, so that it is loaded into the cache while we do something else.
+   *
+   * All the cache lines spanned by the node are requested. Nothing happens if
+   * the given index is not valid, or if the compiler does not support
+   * `__builtin_prefetch`.
+   *
+   * @param x
+   */
+  void prefetch(stack_type x) const noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    if (x != end() && x <= pool.size()) {
+      const char* address = reinterpret_cast<const char*>(&pool[x - 1]);
+      for (std::size_t offset = 0; offset < sizeof(node_t); offset += 64)
+        __builtin_prefetch(address + offset);
+    }
+#else
+    (void)x;
+#endif
+  }
+
   /**
    * @brief Push an element to the front of the stack. Returns the new head of
    * the stack.
@@ -313,11 +651,13 @@ class stack_pool {
    * @return stack_type
    */
   stack_type pop(stack_type head) {
-    stack_type new_stack_head = next(head);
+    stack_type new_stack_head = node(head).next;
 
     // the newly freed node becomes the head of the stack of free nodes
-    next(head) = free_nodes;
-    free_nodes = head;
+    set_next(head, free_list());
+    free_list() = head;
+    mark_free(head);
+    count(events.pops);
 
     return new_stack_head;
   }
@@ -335,24 +675,549 @@ class stack_pool {
    * @return stack_type
    */
   stack_type free_stack(stack_type head) {
+    count(events.free_stacks);
     if (empty(head))
       return head;
 
     // we look for the bottom-element of this stack, and make it point to the
     // head of the stack free_nodes
-    iterator current_node = begin(head);
-    iterator next_node = current_node;
+    const_iterator current_node = cbegin(head);
+    const_iterator next_node = current_node;
     ++next_node;
-    while (next_node != end(head))
+    while (next_node != cend(head)) {
+      mark_free(current_node.ptr_to_stack());
       current_node = next_node++;
+    }
+    mark_free(current_node.ptr_to_stack());
 
-    next(current_node.ptr_to_stack()) = free_nodes;
+    set_next(current_node.ptr_to_stack(), free_list());
     // the head of the free_nodes stack is now the former head of the old stack
-    free_nodes = head;
+    free_list() = head;
 
     // the stack is now empty
     return end();
   }
+
+  /**
+   * @brief Append `n` new nodes at the end of the pool, and return the first
+   * one (or end() if `n` is 0). The nodes are `first, first + 1, ...,
+   * first + n - 1`.
+   *
+   * The new nodes hold default constructed values, their next is end(), and
+   * they count as live although they belong to no stack yet: they are meant
+   * to be linked into stacks through value() and next() by the caller, which
+   * is how bulk builders lay out whole stacks at once. Different nodes can be
+   * written by different threads, as long as the pool is not modified
+   * otherwise: the links of new nodes are not recorded in the undo log, even
+   * if a checkpoint is active. The free nodes are not used.
+   *
+   * This method throws std::length_error if the nodes would not be
+   * addressable by N.
+   *
+   * @param n Number of nodes.
+   * @return stack_type
+   */
+  stack_type allocate_block(size_type n) {
+    const size_type first = pool.size();
+    if (n > size_type(std::numeric_limits<stack_type>::max()) - first)
+      throw std::length_error("The new nodes would not be addressable.");
+    if (n == 0)
+      return end();
+    if (first + n > pool.capacity())
+      count(events.reallocations);
+    pool.resize(first + n);
+    if (liveness_tracked) {
+      live_nodes.resize((first + n + 63) / 64, 0);
+      for (size_type i = first; i < first + n; ++i)
+        live_nodes[i / 64] |= std::uint64_t(1) << (i % 64);
+    }
+    return stack_type(first + 1);
+  }
+
+  /**
+   * @brief Enable or disable the liveness bitmap, which keeps track of the
+   * nodes belonging to some stack (i.e. not free). When enabled, push, pop
+   * and free_stack keep it up to date, and for_each_live and count_live do
+   * not need to visit the stack of free nodes.
+   *
+   * Enabling the bitmap takes O(size of the pool).
+   *
+   * @param enable
+   */
+  void track_liveness(bool enable) {
+    live_nodes = enable ? compute_live_nodes() : std::vector<std::uint64_t>{};
+    liveness_tracked = enable;
+    for (auto& c : checkpoints)
+      c.bitmap_valid = false;
+  }
+
+  /**
+   * @brief Check whether the liveness bitmap is maintained.
+   */
+  bool tracks_liveness() const noexcept { return liveness_tracked; }
+
+  /**
+   * @brief Enable or disable the counters of push, pop, free_stack and
+   * reallocations reported by stats. They are disabled by default, and cost
+   * a predictable branch per operation.
+   *
+   * Disabling the counters keeps the events counted so far.
+   *
+   * @param enable
+   */
+  void count_events(bool enable) noexcept { events_counted = enable; }
+
+  /**
+   * @brief Check whether the events are counted.
+   */
+  bool counts_events() const noexcept { return events_counted; }
+
+  /**
+   * @brief Call `f(x, value(x))` for each node `x` which belongs to some
+   * stack, in storage order (which is not the order of the stacks).
+   *
+   * The nodes are visited with a sequential scan of the pool, which is much
+   * faster than following the `next` indices of each stack. If the liveness
+   * bitmap is not tracked, it is computed first by visiting the stack of free
+   * nodes. `f` must not push to, or pop from, the pool.
+   *
+   * @tparam F A callable object taking a stack_type and a `T&`.
+   * @param f
+   */
+  template <typename F>
+  void for_each_live(F f) {
+    node_t* nodes = pool.data();
+    auto visit = [nodes, &f](std::size_t i) {
+      f(stack_type(i + 1), nodes[i].value);
+    };
+    if (liveness_tracked)
+      for_each_bit(live_nodes, visit);
+    else
+      for_each_bit(compute_live_nodes(), visit);
+  }
+  template <typename F>
+  void for_each_live(F f) const {
+    const node_t* nodes = pool.data();
+    auto visit = [nodes, &f](std::size_t i) {
+      f(stack_type(i + 1), nodes[i].value);
+    };
+    if (liveness_tracked)
+      for_each_bit(live_nodes, visit);
+    else
+      for_each_bit(compute_live_nodes(), visit);
+  }
+
+  /**
+   * @brief Return the number of nodes which belong to some stack.
+   *
+   * This is O(size of the pool / 64) if the liveness bitmap is tracked,
+   * otherwise the stack of free nodes is visited.
+   *
+   * @return size_type
+   */
+  size_type count_live() const noexcept {
+    if (liveness_tracked) {
+      size_type n = 0;
+      for (auto w : live_nodes)
+        n += __builtin_popcountll(w);
+      return n;
+    }
+    size_type n = pool.size();
+    for (stack_type f : {free_nodes, retired})
+      for (stack_type x = f; x != end(); x = pool[x - 1].next)
+        --n;
+    return n;
+  }
+
+  /**
+   * @brief Free all the nodes which cannot be reached from the given heads,
+   * and return how many they are.
+   *
+   * Popping a node which is not the head of its stack, or losing the head of
+   * a stack, leaks the nodes above it. This method marks the nodes reachable
+   * from `roots` (and the free nodes) in a bitmap, following each stack until
+   * a node which is already marked, then sweeps the pool sequentially and
+   * frees everything else. It takes O(size of the pool) time, and one bit per
+   * node of additional memory.
+   *
+   * The reclaimed nodes are freed as by pop, therefore this works with the
+   * liveness bitmap and inside a checkpoint.
+   *
+   * This method throws an exception if some head is not a valid index in the
+   * pool, before modifying anything.
+   *
+   * @param roots The heads of all the stacks in use.
+   * @return size_type
+   */
+  size_type reclaim_unreachable(const std::vector<stack_type>& roots) {
+    // check the roots first, so that nothing is modified if one is invalid
+    for (stack_type x : roots)
+      if (x != end())
+        (void)node(x);
+
+    std::vector<std::uint64_t> marked((pool.size() + 63) / 64, 0);
+    // set the bit of x, return false if it was already set
+    auto mark = [&marked](stack_type x) {
+      std::uint64_t& word = marked[(x - 1) / 64];
+      const std::uint64_t bit = std::uint64_t(1) << ((x - 1) % 64);
+      const bool fresh = !(word & bit);
+      word |= bit;
+      return fresh;
+    };
+
+    // the stacks are walked in groups, advancing each one by a node at a time
+    // and prefetching the next node (as in stack_utils::batched_walk), so
+    // that many cache misses are served at the same time. A walk stops at the
+    // first node already marked, since the rest of the stack is marked too
+    const size_type n_sources = roots.size() + 2;
+    auto source = [&](size_type i) {
+      return i < roots.size() ? roots[i]
+                              : (i == roots.size() ? free_nodes : retired);
+    };
+    stack_type cursors[16];
+    size_type n_cursors = 0;
+    size_type next_source = 0;
+    while (n_cursors < 16 && next_source < n_sources)
+      cursors[n_cursors++] = source(next_source++);
+    while (n_cursors > 0) {
+      for (size_type k = 0; k < n_cursors; ++k) {
+        stack_type& x = cursors[k];
+        if (x != end() && mark(x)) {
+          x = pool[x - 1].next;
+          prefetch(x);
+        } else if (next_source < n_sources) {
+          x = source(next_source++);
+        } else {
+          x = cursors[--n_cursors];
+          --k;
+        }
+      }
+    }
+
+    // sweep from the bottom of the pool, so that the free nodes with small
+    // indexes are reused first
+    size_type reclaimed = 0;
+    for (size_type w = marked.size(); w-- > 0;) {
+      if (marked[w] == ~std::uint64_t(0))
+        continue;
+      const size_type bits = std::min<size_type>(64, pool.size() - w * 64);
+      for (size_type i = bits; i-- > 0;) {
+        if (marked[w] & (std::uint64_t(1) << i))
+          continue;
+        const stack_type x = stack_type(w * 64 + i + 1);
+        set_next(x, free_list());
+        free_list() = x;
+        mark_free(x);
+        ++reclaimed;
+      }
+    }
+    return reclaimed;
+  }
+
+  /**
+   * @brief Translates the heads of a pool merged by merge_from into heads of
+   * the pool which received its nodes.
+   */
+  struct head_translator {
+    // index of the first node of the merged pool, minus one
+    stack_type offset;
+
+    stack_type operator()(stack_type x) const noexcept {
+      return x == stack_type(0) ? x : stack_type(x + offset);
+    }
+  };
+
+  /**
+   * @brief Move all the nodes of `other` (stacks and free nodes) at the end of
+   * this pool, and return the function which translates the heads of `other`
+   * into heads of this pool. `other` is empty afterwards.
+   *
+   * The nodes are moved in bulk (a memmove when T is trivially copyable),
+   * then their links are shifted by a constant in a sequential pass, and the
+   * free nodes of `other` are put on top of the free nodes of this pool. This
+   * takes O(size of other), and does not touch the existing nodes. If this
+   * pool has no nodes at all, the storage of `other` is taken in O(1).
+   *
+   * Merging inside a checkpoint is allowed: a rollback drops the merged
+   * nodes. This method throws std::length_error if the merged pool would not
+   * be addressable by N, std::logic_error if `other` has a checkpoint, and
+   * std::invalid_argument if `other` is this pool. Nothing is modified in
+   * these cases.
+   *
+   * @param other
+   * @return head_translator
+   */
+  head_translator merge_from(stack_pool&& other) {
+    if (&other == this)
+      throw std::invalid_argument("Cannot merge a pool into itself.");
+    if (other.checkpointing())
+      throw std::logic_error("Cannot merge a pool which has a checkpoint.");
+    const size_type offset = pool.size();
+    if (other.pool.size() >
+        size_type(std::numeric_limits<stack_type>::max()) - offset)
+      throw std::length_error("The merged pool would not be addressable.");
+
+    const std::vector<std::uint64_t> other_live =
+        !liveness_tracked ? std::vector<std::uint64_t>{}
+        : other.liveness_tracked ? std::move(other.live_nodes)
+                                 : other.compute_live_nodes();
+
+    const stack_type shift = stack_type(offset);
+    if (pool.empty()) {
+      // nothing to shift, the storage of other is taken as it is
+      pool = std::move(other.pool);
+    } else {
+      pool.insert(pool.end(), std::make_move_iterator(other.pool.begin()),
+                  std::make_move_iterator(other.pool.end()));
+      // branch-free, so that the loop can be vectorized
+      for (size_type i = offset; i < pool.size(); ++i)
+        pool[i].next += shift * stack_type(pool[i].next != stack_type(0));
+    }
+
+    // the free nodes of other go on top of the free nodes of this pool. The
+    // bottom of those of other is a merged node, therefore this link needs
+    // no undo log
+    const head_translator translate{shift};
+    if (free_nodes != end() && other.free_nodes != end()) {
+      stack_type bottom = translate(other.free_nodes);
+      while (pool[bottom - 1].next != end())
+        bottom = pool[bottom - 1].next;
+      pool[bottom - 1].next = free_nodes;
+    }
+    if (other.free_nodes != end())
+      free_nodes = translate(other.free_nodes);
+
+    if (liveness_tracked) {
+      live_nodes.resize((pool.size() + 63) / 64, 0);
+      for_each_bit(other_live, [this, offset](std::size_t i) {
+        const std::size_t x = offset + i;
+        live_nodes[x / 64] |= std::uint64_t(1) << (x % 64);
+      });
+    }
+
+    events.pushes += other.events.pushes;
+    events.pops += other.events.pops;
+    events.free_stacks += other.events.free_stacks;
+    events.reallocations += other.events.reallocations;
+
+    other = stack_pool{};
+    return translate;
+  }
+
+  /**
+   * @brief Take a checkpoint of the pool, which can be restored by rollback()
+   * or discarded by commit(). Checkpoints can be nested.
+   *
+   * While a checkpoint is active each change to the links of the nodes is
+   * recorded in an undo log, so that rollback() takes O(changes) rather than
+   * O(size of the pool). Nodes freed by pop and free_stack are not reused
+   * until the outermost checkpoint is committed, therefore their values are
+   * still there after a rollback. Values modified through value() are not
+   * restored.
+   */
+  void checkpoint() {
+    checkpoints.push_back(checkpoint_t{undo_links.size(), undo_flips.size(),
+                                       pool.size(), free_nodes, retired,
+                                       true});
+  }
+
+  /**
+   * @brief Restore the state of the pool at the last checkpoint, and discard
+   * the checkpoint. Heads which were valid at that moment are valid again,
+   * and refer to the same values.
+   *
+   * This method throws std::logic_error if there is no checkpoint.
+   */
+  void rollback() {
+    if (!checkpointing())
+      throw std::logic_error("There is no checkpoint to roll back to.");
+    const checkpoint_t c = checkpoints.back();
+    checkpoints.pop_back();
+
+    // undo in reverse order, nodes allocated after the checkpoint are dropped
+    for (size_type i = undo_links.size(); i > c.links; --i) {
+      const link_change& l = undo_links[i - 1];
+      if (l.node <= c.size)
+        pool[l.node - 1].next = l.next;
+    }
+    undo_links.resize(c.links);
+
+    if (liveness_tracked && c.bitmap_valid) {
+      for (size_type i = c.flips; i < undo_flips.size(); ++i)
+        if (undo_flips[i] <= c.size)
+          flip(undo_flips[i]);
+    }
+    undo_flips.resize(c.flips);
+
+    pool.erase(pool.begin() + c.size, pool.end());
+    free_nodes = c.free_nodes;
+    retired = c.retired;
+
+    if (liveness_tracked) {
+      if (c.bitmap_valid) {
+        live_nodes.resize((c.size + 63) / 64);
+        if (c.size % 64 != 0)
+          live_nodes.back() &= (std::uint64_t(1) << (c.size % 64)) - 1;
+      } else {
+        live_nodes = compute_live_nodes();
+      }
+    }
+  }
+
+  /**
+   * @brief Keep the changes made after the last checkpoint, and discard the
+   * checkpoint. They can still be undone by the rollback of an outer
+   * checkpoint. When the outermost checkpoint is committed, the undo log is
+   * cleared and the nodes freed in the meanwhile can be reused.
+   *
+   * This method throws std::logic_error if there is no checkpoint.
+   */
+  void commit() {
+    if (!checkpointing())
+      throw std::logic_error("There is no checkpoint to commit.");
+    checkpoints.pop_back();
+    if (checkpointing())
+      return;
+
+    undo_links.clear();
+    undo_flips.clear();
+    if (retired != end()) {
+      stack_type bottom = retired;
+      while (pool[bottom - 1].next != end())
+        bottom = pool[bottom - 1].next;
+      pool[bottom - 1].next = free_nodes;
+      free_nodes = retired;
+      retired = end();
+    }
+  }
+
+  /**
+   * @brief Return the number of active (nested) checkpoints.
+   */
+  size_type checkpoint_depth() const noexcept { return checkpoints.size(); }
+
+  /**
+   * @brief Return the number of link changes recorded in the undo log since
+   * the outermost checkpoint (0 if there is no checkpoint).
+   */
+  size_type undo_log_size() const noexcept { return undo_links.size(); }
+
+  /**
+   * @brief Write the nodes and the stack of free nodes to a binary stream,
+   * in the native byte order. Heads are not written: they are valid again in
+   * the pool returned by load().
+   *
+   * T must be trivially copyable. This method throws std::logic_error if a
+   * checkpoint is active, since the nodes retired meanwhile would be lost.
+   *
+   * @param os
+   */
+  void save(std::ostream& os) const {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Only pools of trivially copyable values can be saved.");
+    if (checkpointing())
+      throw std::logic_error("Cannot save a pool which has a checkpoint.");
+    const std::uint64_t header[5] = {saved_magic, sizeof(T), sizeof(N),
+                                     pool.size(), free_nodes};
+    os.write(reinterpret_cast<const char*>(header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(pool.data()),
+             std::streamsize(pool.size() * sizeof(node_t)));
+  }
+
+  /**
+   * @brief Read a pool written by save(), with the same T and N. The
+   * liveness bitmap is not tracked.
+   *
+   * This throws std::runtime_error if the stream does not hold such a pool.
+   *
+   * @param is
+   * @return stack_pool
+   */
+  static stack_pool load(std::istream& is) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Only pools of trivially copyable values can be saved.");
+    std::uint64_t header[5];
+    if (!is.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        header[0] != saved_magic || header[1] != sizeof(T) ||
+        header[2] != sizeof(N) ||
+        header[3] > std::numeric_limits<stack_type>::max() ||
+        header[4] > header[3])
+      throw std::runtime_error("Not a saved stack_pool of this type.");
+    stack_pool p;
+    p.free_nodes = stack_type(header[4]);
+    // the nodes are read chunk by chunk, rather than trusting the size in the
+    // header, so that a corrupted size fails on the truncated stream
+    const std::uint64_t chunk = 1 << 16;
+    while (p.pool.size() < header[3]) {
+      const size_type first = p.pool.size();
+      const size_type n = size_type(std::min(chunk, header[3] - first));
+      p.pool.resize(first + n);
+      if (!is.read(reinterpret_cast<char*>(p.pool.data() + first),
+                   std::streamsize(n * sizeof(node_t))))
+        throw std::runtime_error("The saved stack_pool is truncated.");
+    }
+    return p;
+  }
+
+  /**
+   * @brief Return a snapshot of the state of the pool, and of the events
+   * counted while count_events was enabled.
+   *
+   * The nodes are classified with the liveness bitmap, which is computed
+   * first if it is not tracked: this takes O(size of the pool / 64) plus the
+   * time needed to scan the free runs.
+   *
+   * @return stack_pool_stats
+   */
+  stack_pool_stats stats() const {
+    stack_pool_stats s{};
+    s.counts_events = events_counted;
+    s.pushes = events.pushes;
+    s.pops = events.pops;
+    s.free_stacks = events.free_stacks;
+    s.reallocations = events.reallocations;
+
+    const std::vector<std::uint64_t> computed =
+        liveness_tracked ? std::vector<std::uint64_t>{} : compute_live_nodes();
+    const std::vector<std::uint64_t>& bits =
+        liveness_tracked ? live_nodes : computed;
+
+    // runs of free nodes, i.e. of zeros in the bitmap
+    std::size_t run = 0;
+    for (std::size_t w = 0; w < bits.size(); ++w) {
+      const std::size_t n_bits =
+          std::min<std::size_t>(64, pool.size() - w * 64);
+      s.live_nodes += __builtin_popcountll(bits[w]);
+      if (bits[w] == 0) {
+        run += n_bits;
+        continue;
+      }
+      for (std::size_t i = 0; i < n_bits; ++i) {
+        if (bits[w] & (std::uint64_t(1) << i)) {
+          s.largest_free_run = std::max(s.largest_free_run, run);
+          run = 0;
+        } else {
+          ++run;
+        }
+      }
+    }
+    s.largest_free_run = std::max(s.largest_free_run, run);
+
+    s.nodes = pool.size();
+    s.free_nodes = s.nodes - s.live_nodes;
+    s.fragmentation =
+        s.free_nodes == 0
+            ? 0.0
+            : 1.0 - double(s.largest_free_run) / double(s.free_nodes);
+
+    s.bytes_reserved = pool.capacity() * sizeof(node_t) +
+                       live_nodes.capacity() * sizeof(std::uint64_t) +
+                       checkpoints.capacity() * sizeof(checkpoint_t) +
+                       undo_links.capacity() * sizeof(link_change) +
+                       undo_flips.capacity() * sizeof(stack_type);
+    s.bytes_used = s.live_nodes * sizeof(node_t);
+    return s;
+  }
 };
 
 namespace stack_utils {
@@ -408,7 +1273,12 @@ namespace stack_utils {
   template <typename value_type, typename stack_type>
   std::vector<value_type> to_vector(stack_pool<value_type, stack_type>& pool,
                                     stack_type head) {
+    // reserve first, since a growing vector may copy the values
+    std::size_t size = 0;
+    for (auto it = pool.cbegin(head); it != pool.cend(head); ++it)
+      ++size;
     std::vector<value_type> v;
+    v.reserve(size);
     if (!pool.empty(head)) {
       do {
         v.push_back(std::move(pool.value(head)));
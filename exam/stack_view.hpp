@@ -0,0 +1,98 @@
+#pragma once
+
+#include "stack_pool.hpp"
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if __cplusplus >= 202002L
+#  include <ranges>
+#endif
+
+/**
+ * @brief A lightweight view over a stack of a stack_pool.
+ *
+ * The view holds a pointer to the pool and the head of the stack, so it is
+ * cheap to copy. Its iterators are unchecked_stack_iterator, which are
+ * regular forward iterators (default constructible, copyable from const
+ * objects, with a valid moved-from state), and `end()` returns an iterator as
+ * well, therefore the view can be passed to the algorithms in `<algorithm>`.
+ * When compiled as C++20, the view is a `std::ranges::forward_range` and a
+ * `std::ranges::view`. Iterators also compare with stack_sentinel, which can
+ * be used as the end of any stack.
+ *
+ * The head is checked when the view is constructed. Iterators are
+ * invalidated if the pool grows.
+ *
+ * To run parallel algorithms (e.g. `std::execution::par`), which need random
+ * access iterators, copy the values into a vector with materialize().
+ *
+ * @tparam P Type of the stack pool (possibly const).
+ */
+template <typename P>
+class stack_view
+#if __cplusplus >= 202002L
+    : public std::ranges::view_interface<stack_view<P>>
+#endif
+{
+  P* pool;
+  using stack_type = decltype(std::declval<P&>().end());
+  stack_type head;
+
+ public:
+  using iterator =
+      decltype(std::declval<P&>().unchecked_begin(std::declval<stack_type>()));
+  using value_type = typename std::iterator_traits<iterator>::value_type;
+
+  stack_view() noexcept : pool{nullptr}, head{0} {}
+
+  /**
+   * @brief Construct a view over the stack starting at `x`.
+   *
+   * This throws an exception if the given head is not a valid index in the
+   * pool.
+   *
+   * @param p
+   * @param x
+   */
+  stack_view(P& p, stack_type x) : pool{&p}, head{x} {
+    // this throws if x is not valid
+    if (!p.empty(x))
+      (void)p.value(x);
+  }
+
+  iterator begin() const noexcept {
+    return pool ? pool->unchecked_begin(head) : iterator();
+  }
+  iterator end() const noexcept { return iterator(); }
+
+  bool empty() const noexcept { return head == stack_type(0); }
+
+  /**
+   * @brief Copy the values of the stack (from top to bottom) into a vector,
+   * which is empty for a default constructed view.
+   *
+   * @return std::vector<value_type>
+   */
+  std::vector<value_type> materialize() const {
+    std::vector<value_type> v;
+    if (pool == nullptr)
+      return v;
+    pool->for_each(head, [&v](const value_type& x) { v.push_back(x); });
+    return v;
+  }
+};
+
+/**
+ * @brief Create a stack_view over the stack starting at `head`.
+ */
+template <typename P, typename H>
+stack_view<P> make_stack_view(P& pool, H head) {
+  return stack_view<P>(pool, head);
+}
+
+#if __cplusplus >= 202002L
+// iterators point into the pool, they outlive the view
+template <typename P>
+inline constexpr bool std::ranges::enable_borrowed_range<stack_view<P>> = true;
+#endif
@@ -170,6 +170,16 @@ SCENARIO("using iterators") {
       REQUIRE(*m == 9);
     }
 
+    THEN("a moved-from iterator can be moved again") {
+      auto a = pool.begin(l1);
+      auto b = std::move(a);
+      auto c = std::move(a);
+      a = std::move(c);
+      REQUIRE(b == pool.begin(l1));
+      REQUIRE(a == pool.end(l1));
+      REQUIRE(c == pool.end(l1));
+    }
+
     THEN("find the min on l2") {
       auto m = std::min_element(pool.begin(l2), pool.end(l2));
       REQUIRE(*m == 1);
@@ -246,3 +256,374 @@ SCENARIO("stack_utils namespace") {
     REQUIRE(stack_utils::stack_size(pool, l) == 8);
   }
 }
+
+SCENARIO("using unchecked iterators") {
+  stack_pool<int, uint16_t> pool{};
+  auto l = pool.new_stack();
+  for (int i = 0; i < 10; ++i)
+    l = pool.push(i, l);
+
+  THEN("they visit the same values as checked iterators") {
+    std::vector<int> expected(pool.begin(l), pool.end(l));
+    std::vector<int> v;
+    for (auto it = pool.unchecked_begin(l); it != pool.unchecked_end(l); ++it)
+      v.push_back(*it);
+    REQUIRE(v == expected);
+  }
+
+  THEN("for_each visits the values from top to bottom") {
+    std::vector<int> v;
+    pool.for_each(l, [&v](int& x) { v.push_back(x++); });
+    REQUIRE(v == std::vector<int>{9, 8, 7, 6, 5, 4, 3, 2, 1, 0});
+    REQUIRE(pool.value(l) == 10);
+
+    const auto& cpool = pool;
+    int sum = 0;
+    cpool.for_each(l, [&sum](const int& x) { sum += x; });
+    REQUIRE(sum == 55);
+  }
+
+  THEN("the sentinel compares equal to the end of any stack") {
+    auto empty = pool.new_stack();
+    REQUIRE(pool.unchecked_begin(empty) == pool.unchecked_end(empty));
+    REQUIRE(pool.unchecked_end(l) != pool.unchecked_begin(l));
+
+    auto it = pool.unchecked_begin(l);
+    auto old = it++;
+    REQUIRE(*old == 9);
+    REQUIRE(*it == 8);
+  }
+}
+
+SCENARIO("visiting all the live nodes") {
+  for (bool tracked : {false, true}) {
+    stack_pool<int, uint16_t> pool{};
+    pool.track_liveness(tracked);
+    REQUIRE(pool.tracks_liveness() == tracked);
+
+    std::vector<uint16_t> heads(5, pool.end());
+    for (int i = 0; i < 200; ++i)
+      heads[i % 5] = pool.push(i, heads[i % 5]);
+    heads[1] = pool.free_stack(heads[1]);
+    heads[3] = pool.pop(heads[3]);
+    heads[3] = pool.pop(heads[3]);
+    heads[4] = pool.push(1000, heads[4]);
+
+    THEN("count_live counts the nodes in the stacks") {
+      std::size_t expected = 0;
+      for (auto h : heads)
+        expected += stack_utils::stack_size(pool, h);
+      REQUIRE(pool.count_live() == expected);
+    }
+
+    THEN("for_each_live visits each node in the stacks once") {
+      long expected = 0;
+      for (auto h : heads)
+        for (auto it = pool.cbegin(h); it != pool.cend(h); ++it)
+          expected += *it;
+
+      long sum = 0;
+      uint16_t last = 0;
+      pool.for_each_live([&](uint16_t x, int& v) {
+        REQUIRE(x > last);
+        REQUIRE(pool.value(x) == v);
+        last = x;
+        sum += v;
+      });
+      REQUIRE(sum == expected);
+    }
+
+    THEN("tracking can be enabled later") {
+      auto before = pool.count_live();
+      pool.track_liveness(!tracked);
+      REQUIRE(pool.count_live() == before);
+      heads[0] = pool.pop(heads[0]);
+      REQUIRE(pool.count_live() == before - 1);
+    }
+  }
+}
+
+SCENARIO("checkpoints of the pool") {
+  for (bool tracked : {false, true}) {
+    stack_pool<int, uint16_t> pool{};
+    pool.track_liveness(tracked);
+
+    auto l1 = pool.new_stack();
+    auto l2 = pool.new_stack();
+    for (int i = 0; i < 10; ++i)
+      l1 = pool.push(i, l1);
+    for (int i = 10; i < 15; ++i)
+      l2 = pool.push(i, l2);
+    l2 = pool.pop(l2);
+
+    auto values = [&pool](uint16_t head) {
+      std::vector<int> v;
+      for (auto it = pool.cbegin(head); it != pool.cend(head); ++it)
+        v.push_back(*it);
+      return v;
+    };
+    const auto v1 = values(l1);
+    const auto v2 = values(l2);
+    const auto live = pool.count_live();
+
+    pool.checkpoint();
+    REQUIRE(pool.checkpoint_depth() == 1);
+    auto s1 = l1;
+    auto s2 = l2;
+
+    // pop, free and reuse nodes, and grow the pool
+    for (int i = 0; i < 3; ++i)
+      s1 = pool.pop(s1);
+    s2 = pool.free_stack(s2);
+    for (int i = 100; i < 120; ++i)
+      s2 = pool.push(i, s2);
+    s1 = pool.push(-1, s1);
+
+    THEN("a rollback restores the stacks") {
+      pool.rollback();
+      REQUIRE(pool.checkpoint_depth() == 0);
+      REQUIRE(values(l1) == v1);
+      REQUIRE(values(l2) == v2);
+      REQUIRE(pool.count_live() == live);
+
+      THEN("the pool works as before") {
+        l1 = pool.pop(l1);
+        l2 = pool.push(42, l2);
+        REQUIRE(pool.count_live() == live);
+        REQUIRE(pool.value(l2) == 42);
+      }
+    }
+
+    THEN("a commit keeps the changes") {
+      pool.commit();
+      REQUIRE(values(s1).front() == -1);
+      REQUIRE(values(s1).size() == 8);
+      REQUIRE(values(s2).size() == 20);
+      REQUIRE(pool.count_live() == 28);
+      REQUIRE_THROWS_AS(pool.commit(), std::logic_error);
+      REQUIRE_THROWS_AS(pool.rollback(), std::logic_error);
+
+      THEN("freed nodes are reused") {
+        const auto capacity = pool.capacity();
+        for (int i = 0; i < 4; ++i)
+          s1 = pool.push(i, s1);
+        REQUIRE(pool.capacity() == capacity);
+        REQUIRE(pool.count_live() == 32);
+      }
+    }
+
+    THEN("an inner checkpoint can be rolled back") {
+      auto inner_s1 = values(s1);
+      pool.checkpoint();
+      pool.free_stack(s1);
+      s2 = pool.push(7, s2);
+      REQUIRE(pool.checkpoint_depth() == 2);
+
+      pool.rollback();
+      REQUIRE(values(s1) == inner_s1);
+      pool.commit();
+      REQUIRE(values(s1) == inner_s1);
+    }
+
+    THEN("an inner checkpoint can be committed") {
+      pool.checkpoint();
+      pool.free_stack(s1);
+      s2 = pool.push(7, s2);
+
+      pool.commit();
+      REQUIRE(pool.count_live() == 21);
+      REQUIRE(pool.value(s2) == 7);
+      pool.rollback();
+      REQUIRE(values(l1) == v1);
+      REQUIRE(values(l2) == v2);
+      REQUIRE(pool.count_live() == live);
+    }
+
+    THEN("liveness tracking can change during a checkpoint") {
+      pool.track_liveness(!tracked);
+      pool.rollback();
+      REQUIRE(pool.count_live() == live);
+      pool.track_liveness(tracked);
+      REQUIRE(pool.count_live() == live);
+    }
+  }
+}
+
+SCENARIO("reclaiming unreachable nodes") {
+  for (bool tracked : {false, true}) {
+    stack_pool<int, uint16_t> pool{};
+    pool.track_liveness(tracked);
+
+    auto l1 = pool.new_stack();
+    auto l2 = pool.new_stack();
+    for (int i = 0; i < 100; ++i)
+      l1 = pool.push(i, l1);
+    for (int i = 0; i < 50; ++i)
+      l2 = pool.push(i, l2);
+    l2 = pool.pop(l2);
+
+    // pop a node in the middle of l1: the 10 nodes above it leak
+    auto middle = l1;
+    for (int i = 0; i < 10; ++i)
+      middle = pool.next(middle);
+    auto below = pool.pop(middle);
+    // and lose the head of a stack
+    auto lost = pool.new_stack();
+    for (int i = 0; i < 20; ++i)
+      lost = pool.push(i, lost);
+    REQUIRE(pool.count_live() == 100 - 1 + 49 + 20);
+
+    THEN("the nodes which cannot be reached are freed") {
+      REQUIRE(pool.reclaim_unreachable({below, l2}) == 10 + 20);
+      REQUIRE(pool.count_live() == 89 + 49);
+      REQUIRE(stack_utils::stack_size(pool, below) == 89);
+      REQUIRE(stack_utils::stack_size(pool, l2) == 49);
+      REQUIRE(pool.reclaim_unreachable({below, l2}) == 0);
+
+      // the reclaimed nodes are reused
+      const auto capacity = pool.capacity();
+      for (int i = 0; i < 30; ++i)
+        l2 = pool.push(i, l2);
+      REQUIRE(pool.capacity() == capacity);
+      REQUIRE(stack_utils::stack_size(pool, below) == 89);
+    }
+
+    THEN("shared tails are marked once") {
+      REQUIRE(pool.reclaim_unreachable({below, pool.next(below), l2, l2}) ==
+              30);
+    }
+
+    THEN("without roots everything is freed") {
+      REQUIRE(pool.reclaim_unreachable({}) == 89 + 49 + 30);
+      REQUIRE(pool.count_live() == 0);
+    }
+
+    THEN("invalid roots are detected before modifying the pool") {
+      REQUIRE_THROWS(pool.reclaim_unreachable({below, 60000}));
+      REQUIRE(pool.count_live() == 100 - 1 + 49 + 20);
+    }
+
+    THEN("reclaimed nodes come back on rollback") {
+      pool.checkpoint();
+      REQUIRE(pool.reclaim_unreachable({below}) == 10 + 20 + 49);
+      pool.rollback();
+      REQUIRE(stack_utils::stack_size(pool, l2) == 49);
+      REQUIRE(stack_utils::stack_size(pool, lost) == 20);
+      REQUIRE(pool.count_live() == 100 - 1 + 49 + 20);
+    }
+  }
+}
+
+SCENARIO("merging pools") {
+  for (bool tracked : {false, true}) {
+    stack_pool<int, uint16_t> pool{};
+    pool.track_liveness(tracked);
+    auto l1 = pool.new_stack();
+    for (int i = 0; i < 10; ++i)
+      l1 = pool.push(i, l1);
+    l1 = pool.pop(l1);
+
+    stack_pool<int, uint16_t> other{};
+    auto o1 = other.new_stack();
+    auto o2 = other.new_stack();
+    for (int i = 0; i < 20; ++i) {
+      o1 = other.push(100 + i, o1);
+      o2 = other.push(200 + i, o2);
+    }
+    o2 = other.pop(other.pop(o2));
+
+    auto translate = pool.merge_from(std::move(other));
+    REQUIRE(other.capacity() == 0);
+    REQUIRE(other.count_live() == 0);
+
+    THEN("the stacks of both pools are found") {
+      REQUIRE(translate(other.end()) == pool.end());
+      REQUIRE(stack_utils::stack_size(pool, l1) == 9);
+      auto v1 = stack_utils::to_vector(pool, translate(o1));
+      REQUIRE(v1.size() == 20);
+      REQUIRE(v1.front() == 119);
+      REQUIRE(v1.back() == 100);
+      REQUIRE(stack_utils::stack_size(pool, translate(o2)) == 18);
+      REQUIRE(pool.value(translate(o2)) == 217);
+      REQUIRE(pool.count_live() == 9 + 18);
+    }
+
+    THEN("the free nodes of both pools are reused") {
+      const auto capacity = pool.capacity();
+      auto l = pool.new_stack();
+      for (int i = 0; i < 3; ++i)
+        l = pool.push(i, l);
+      REQUIRE(pool.capacity() == capacity);
+      REQUIRE(pool.count_live() == 9 + 20 + 18 + 3);
+      REQUIRE(pool.value(translate(o2)) == 217);
+      REQUIRE(pool.value(l1) == 8);
+    }
+
+    THEN("a pool without nodes takes the nodes as they are") {
+      stack_pool<int, uint16_t> empty{100};
+      empty.track_liveness(tracked);
+      auto t = empty.merge_from(std::move(pool));
+      REQUIRE(t(l1) == l1);
+      REQUIRE(stack_utils::stack_size(empty, l1) == 9);
+      REQUIRE(stack_utils::stack_size(empty, translate(o2)) == 18);
+      REQUIRE(empty.count_live() == 9 + 20 + 18);
+      auto l = empty.push(5, empty.new_stack());
+      REQUIRE(l <= 50);
+    }
+
+    THEN("a rollback drops the merged nodes") {
+      stack_pool<int, uint16_t> third{};
+      third.push(7, third.new_stack());
+      pool.checkpoint();
+      auto t = pool.merge_from(std::move(third));
+      REQUIRE(pool.value(t(1)) == 7);
+      pool.rollback();
+      REQUIRE(pool.count_live() == 9 + 20 + 18);
+      REQUIRE(stack_utils::stack_size(pool, l1) == 9);
+    }
+
+    THEN("invalid merges do not modify the pools") {
+      stack_pool<int, uint16_t> big{65535 - 40};
+      auto b = big.new_stack();
+      for (int i = 0; i < 65535 - 40; ++i)
+        b = big.push(i, b);
+      REQUIRE_THROWS_AS(pool.merge_from(std::move(big)), std::length_error);
+      REQUIRE(stack_utils::stack_size(big, b) == 65535 - 40);
+      REQUIRE_THROWS_AS(pool.merge_from(std::move(pool)),
+                        std::invalid_argument);
+
+      stack_pool<int, uint16_t> checkpointed{};
+      checkpointed.checkpoint();
+      REQUIRE_THROWS_AS(pool.merge_from(std::move(checkpointed)),
+                        std::logic_error);
+      REQUIRE(pool.count_live() == 9 + 20 + 18);
+    }
+  }
+}
+
+SCENARIO("allocating blocks of nodes") {
+  for (bool tracked : {false, true}) {
+    stack_pool<int, uint16_t> pool{};
+    pool.track_liveness(tracked);
+    auto l = pool.push(1, pool.new_stack());
+    l = pool.push(2, pool.pop(pool.push(3, l)));
+
+    auto first = pool.allocate_block(3);
+    REQUIRE(first == 3);
+    REQUIRE(pool.count_live() == 2 + 3);
+    for (int i = 0; i < 3; ++i) {
+      pool.value(first + i) = 10 + i;
+      REQUIRE(pool.next(first + i) == pool.end());
+    }
+    pool.next(first) = first + 1;
+    pool.next(first + 1) = l;
+    REQUIRE(stack_utils::stack_size(pool, first) == 4);
+    REQUIRE(pool.allocate_block(0) == pool.end());
+
+    pool.checkpoint();
+    pool.allocate_block(10);
+    pool.rollback();
+    REQUIRE(pool.count_live() == 5);
+    REQUIRE_THROWS_AS(pool.allocate_block(65535), std::length_error);
+  }
+}
@@ -0,0 +1,84 @@
+#include "catch.hpp"
+
+#include "augmented_stack_pool.hpp"
+#include <algorithm>  // min_element
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+SCENARIO("aggregates of augmented stacks") {
+  GIVEN("a pool computing the minimum") {
+    augmented_stack_pool<int, monoids::min<int>, std::uint16_t> pool{16};
+    auto l = pool.new_stack();
+    REQUIRE(pool.aggregate(l) == std::numeric_limits<int>::max());
+
+    for (int x : {5, 7, 3, 8, 1, 9})
+      l = pool.push(x, l);
+    REQUIRE(pool.value(l) == 9);
+    REQUIRE(pool.aggregate(l) == 1);
+
+    THEN("popping restores the former aggregate") {
+      l = pool.pop(l);
+      REQUIRE(pool.aggregate(l) == 1);
+      l = pool.pop(l);
+      REQUIRE(pool.aggregate(l) == 3);
+      l = pool.pop(l);
+      l = pool.pop(l);
+      REQUIRE(pool.aggregate(l) == 5);
+    }
+
+    THEN("each node knows the aggregate of the portion below it") {
+      REQUIRE(pool.aggregate(pool.next(pool.next(l))) == 3);
+    }
+
+    THEN("freed nodes are recycled") {
+      l = pool.free_stack(l);
+      REQUIRE(pool.empty(l));
+      l = pool.push(4, l);
+      REQUIRE(pool.aggregate(l) == 4);
+      REQUIRE(l == 6);
+    }
+  }
+
+  GIVEN("a pool computing the sum of strings") {
+    augmented_stack_pool<std::string> pool;
+    auto l = pool.new_stack();
+    l = pool.push("c", l);
+    l = pool.push("b", l);
+    l = pool.push(std::string{"a"}, l);
+    REQUIRE(pool.aggregate(l) == "abc");
+
+    std::string visited;
+    pool.for_each(l, [&visited](const std::string& s) { visited += s; });
+    REQUIRE(visited == "abc");
+  }
+
+  GIVEN("random operations on many stacks") {
+    augmented_stack_pool<long, monoids::max<long>> pool;
+    std::vector<std::size_t> heads(10, pool.end());
+    std::vector<std::vector<long>> mirror(10);
+    std::mt19937 gen{1};
+
+    for (int i = 0; i < 2000; ++i) {
+      auto s = gen() % heads.size();
+      if (gen() % 3 == 0 && !mirror[s].empty()) {
+        heads[s] = pool.pop(heads[s]);
+        mirror[s].pop_back();
+      } else {
+        long x = long(gen() % 1000) - 500;
+        heads[s] = pool.push(x, heads[s]);
+        mirror[s].push_back(x);
+      }
+    }
+
+    THEN("the aggregates match a full scan") {
+      for (std::size_t s = 0; s < heads.size(); ++s) {
+        long expected = monoids::max<long>::identity();
+        for (auto x : mirror[s])
+          expected = std::max(expected, x);
+        REQUIRE(pool.aggregate(heads[s]) == expected);
+      }
+    }
+  }
+}
@@ -0,0 +1,58 @@
+#include "catch.hpp"
+
+#include "batched_traversal.hpp"
+#include <cstdint>
+#include <vector>
+
+SCENARIO("walking many stacks at the same time") {
+  stack_pool<int, std::uint32_t> pool;
+  std::vector<std::uint32_t> heads(30, pool.end());
+  // interleave the nodes of the stacks in the pool
+  for (int i = 0; i < 500; ++i) {
+    auto s = (i * 7) % heads.size();
+    if (s % 5 != 0)
+      heads[s] = pool.push(i, heads[s]);
+  }
+  const auto& cpool = pool;
+
+  for (std::size_t group : {1, 3, 16, 64}) {
+    THEN("batched_stack_sizes agrees with stack_size") {
+      auto sizes = stack_utils::batched_stack_sizes(cpool, heads, group);
+      for (std::size_t i = 0; i < heads.size(); ++i)
+        REQUIRE(sizes[i] == stack_utils::stack_size(cpool, heads[i]));
+    }
+
+    THEN("batched_find_if finds the first matching node") {
+      auto found = stack_utils::batched_find_if(
+          cpool, heads, [](int x) { return x % 3 == 0; }, group);
+      for (std::size_t i = 0; i < heads.size(); ++i) {
+        auto it = cpool.cbegin(heads[i]);
+        while (it != cpool.cend(heads[i]) && *it % 3 != 0)
+          ++it;
+        REQUIRE(found[i] == it.ptr_to_stack());
+      }
+    }
+
+    THEN("batched_for_each visits the nodes of each stack in order") {
+      std::vector<std::vector<int>> seen(heads.size());
+      stack_utils::batched_for_each(
+          pool, heads, [&seen](std::size_t i, int& x) { seen[i].push_back(x); },
+          group);
+      for (std::size_t i = 0; i < heads.size(); ++i) {
+        std::vector<int> expected(cpool.cbegin(heads[i]),
+                                  cpool.cend(heads[i]));
+        REQUIRE(seen[i] == expected);
+      }
+    }
+
+    THEN("a walk inside a checkpoint does not grow the undo log") {
+      pool.checkpoint();
+      std::size_t visited = 0;
+      stack_utils::batched_for_each(
+          pool, heads, [&visited](std::size_t, int&) { ++visited; }, group);
+      REQUIRE(visited == cpool.count_live());
+      REQUIRE(pool.undo_log_size() == 0);
+      pool.rollback();
+    }
+  }
+}
@@ -0,0 +1,115 @@
+#include "catch.hpp"
+
+#include "concurrent_queue.hpp"
+#include <algorithm>  // all_of
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+SCENARIO("using a queue from a single thread") {
+  GIVEN("an unbounded queue") {
+    mpmc_queue<int> q{2};
+    REQUIRE(q.empty());
+
+    WHEN("we push more values than the initial capacity") {
+      for (int i = 0; i < 100; ++i)
+        REQUIRE(q.push(i));
+
+      THEN("values are popped in FIFO order") {
+        int x;
+        for (int i = 0; i < 100; ++i) {
+          REQUIRE(q.pop(x));
+          REQUIRE(x == i);
+        }
+        REQUIRE(!q.pop(x));
+        REQUIRE(q.empty());
+      }
+    }
+  }
+
+  GIVEN("a bounded queue") {
+    bounded_mpmc_queue<int> q{3};
+
+    THEN("it refuses values when it is full") {
+      REQUIRE(q.push(1));
+      REQUIRE(q.push(2));
+      REQUIRE(q.push(3));
+      REQUIRE(!q.push(4));
+
+      int x;
+      REQUIRE(q.pop(x));
+      REQUIRE(x == 1);
+
+      AND_THEN("popped nodes are recycled") {
+        REQUIRE(q.push(4));
+        REQUIRE(!q.push(5));
+        for (int i = 2; i <= 4; ++i) {
+          REQUIRE(q.pop(x));
+          REQUIRE(x == i);
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("pools which are too large to be addressed") {
+  using pool_type = concurrent_node_pool<int>;
+  // an unbounded pool rounds the first chunk up to 2^32 nodes
+  REQUIRE_THROWS_AS((pool_type{(std::size_t(1) << 31) + 1, false}),
+                    std::length_error);
+  REQUIRE_THROWS_AS((pool_type{std::size_t(1) << 63, false}),
+                    std::length_error);
+  REQUIRE_THROWS_AS((pool_type{std::size_t(1) << 32, true}),
+                    std::length_error);
+}
+
+SCENARIO("using a queue from multiple threads") {
+  constexpr int producers = 4;
+  constexpr int per_producer = 20000;
+
+  mpmc_queue<long> q{16};
+  std::atomic<int> popped{0};
+  std::vector<std::vector<long>> received(producers);
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p)
+    threads.emplace_back([&q, p]() {
+      for (long i = 0; i < per_producer; ++i)
+        q.push(p * per_producer + i);
+    });
+  for (int c = 0; c < producers; ++c)
+    threads.emplace_back([&q, &popped, &received, c]() {
+      long x;
+      while (popped.load() < producers * per_producer) {
+        if (q.pop(x)) {
+          received[c].push_back(x);
+          ++popped;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  for (auto& t : threads)
+    t.join();
+
+  THEN("every value is received exactly once") {
+    std::vector<int> seen(producers * per_producer, 0);
+    for (auto& r : received)
+      for (auto x : r)
+        ++seen[x];
+    REQUIRE(std::all_of(seen.begin(), seen.end(),
+                        [](int n) { return n == 1; }));
+  }
+
+  THEN("values of the same producer are received in order") {
+    for (auto& r : received) {
+      std::vector<long> last(producers, -1);
+      for (auto x : r) {
+        REQUIRE(x > last[x / per_producer]);
+        last[x / per_producer] = x;
+      }
+    }
+  }
+}
@@ -0,0 +1,62 @@
+#include "catch.hpp"
+
+#include "fork_snapshot.hpp"
+#include "stack_pool.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+  const std::string snapshot_path = "tests_fork_snapshot.tmp";
+}  // namespace
+
+SCENARIO("snapshots written by a child process") {
+  using pool_type = stack_pool<std::int64_t, std::uint32_t>;
+  pool_type pool;
+  std::vector<std::uint32_t> heads(8, pool.end());
+  for (std::int64_t i = 0; i < 100000; ++i)
+    heads[i % 8] = pool.push(i, heads[i % 8]);
+  const std::vector<std::int64_t> before(pool.cbegin(heads[3]),
+                                         pool.cend(heads[3]));
+
+  fork_snapshot s{snapshot_path,
+                  [&pool](std::ostream& os) { pool.save(os); }};
+  // the parent goes on, without changing the snapshot
+  for (auto& h : heads) {
+    h = pool.pop(h);
+    h = pool.push(-1, h);
+  }
+  for (std::int64_t i = 0; i < 100000; ++i)
+    pool.value(heads[0]) += i;
+  const fork_snapshot_stats stats = s.wait();
+  REQUIRE(s.done());
+  REQUIRE(stats.pause_seconds == s.pause_seconds());
+  REQUIRE(stats.seconds > 0);
+
+  std::ifstream in{snapshot_path, std::ios::binary | std::ios::ate};
+  REQUIRE(std::uint64_t(in.tellg()) == stats.bytes);
+  in.seekg(0);
+  auto loaded = pool_type::load(in);
+  REQUIRE(std::vector<std::int64_t>(loaded.cbegin(heads[3]),
+                                    loaded.cend(heads[3])) == before);
+  REQUIRE(loaded.value(heads[0]) == 99992);
+  std::remove(snapshot_path.c_str());
+
+  THEN("errors of the child are reported by wait") {
+    pool.checkpoint();
+    fork_snapshot failed{snapshot_path,
+                         [&pool](std::ostream& os) { pool.save(os); }};
+    REQUIRE_THROWS_AS(failed.wait(), std::runtime_error);
+    pool.rollback();
+
+    fork_snapshot unwritable{"no_such_directory/snapshot",
+                             [&pool](std::ostream& os) { pool.save(os); }};
+    REQUIRE_THROWS_AS(unwritable.wait(), std::system_error);
+    std::ifstream none{snapshot_path};
+    REQUIRE(!none);
+  }
+}
@@ -0,0 +1,77 @@
+#include "catch.hpp"
+
+#include "frozen_stacks.hpp"
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+SCENARIO("freezing and thawing stacks") {
+  stack_pool<std::string, std::uint32_t> pool;
+  std::vector<std::uint32_t> heads(5, pool.end());
+  // interleaved pushes, so that the stacks are scattered in the pool
+  for (int i = 0; i < 100; ++i) {
+    const std::size_t s = (i * 7) % 5;
+    if (s != 3)
+      heads[s] = pool.push(std::to_string(i), heads[s]);
+  }
+  // a stack sharing its tail with another one
+  heads.push_back(pool.next(heads[0]));
+
+  auto frozen = stack_utils::freeze(pool, heads);
+
+  THEN("each stack is a contiguous range, from top to bottom") {
+    REQUIRE(frozen.size() == 6);
+    REQUIRE(frozen.values().size() == 4 * 20 + 19);
+    for (std::size_t i = 0; i < heads.size(); ++i) {
+      REQUIRE(frozen.length(i) == stack_utils::stack_size(pool, heads[i]));
+      REQUIRE(std::vector<std::string>(frozen.begin(i), frozen.end(i)) ==
+              std::vector<std::string>(pool.cbegin(heads[i]),
+                                       pool.cend(heads[i])));
+    }
+    REQUIRE(frozen.length(3) == 0);
+    REQUIRE(frozen.begin(3) == frozen.end(3));
+    REQUIRE_THROWS_AS(frozen.begin(6), std::out_of_range);
+  }
+
+  THEN("thaw builds the same stacks") {
+    auto thawed = stack_utils::thaw<std::uint16_t>(frozen);
+    REQUIRE(thawed.second.size() == 6);
+    REQUIRE(thawed.first.empty(thawed.second[3]));
+    for (std::size_t i = 0; i < heads.size(); ++i) {
+      auto h = thawed.second[i];
+      REQUIRE(std::vector<std::string>(thawed.first.cbegin(h),
+                                       thawed.first.cend(h)) ==
+              std::vector<std::string>(frozen.begin(i), frozen.end(i)));
+    }
+    REQUIRE(thawed.first.count_live() == frozen.values().size());
+
+    // and the thawed pool can be modified
+    auto& p = thawed.first;
+    auto& h = thawed.second;
+    h[3] = p.push("new", p.pop(h[2]));
+    REQUIRE(stack_utils::stack_size(p, h[3]) == 20);
+  }
+
+  THEN("the values can be given to the standard algorithms") {
+    std::size_t chars = 0;
+    for (std::size_t i = 0; i < frozen.size(); ++i)
+      chars = std::accumulate(frozen.begin(i), frozen.end(i), chars,
+                              [](std::size_t n, const std::string& s) {
+                                return n + s.size();
+                              });
+    REQUIRE(chars > 0);
+  }
+
+  THEN("invalid offsets are rejected") {
+    using frozen_ints = frozen_stacks<int>;
+    REQUIRE(frozen_ints{}.size() == 0);
+    REQUIRE(frozen_ints({1, 2, 3}, {0, 1, 3}).length(1) == 2);
+    REQUIRE_THROWS_AS(frozen_ints({1, 2, 3}, {0, 2}), std::invalid_argument);
+    REQUIRE_THROWS_AS(frozen_ints({1, 2, 3}, {1, 3}), std::invalid_argument);
+    REQUIRE_THROWS_AS(frozen_ints({1, 2, 3}, {0, 2, 1, 3}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(frozen_ints({}, {}), std::invalid_argument);
+  }
+}
@@ -0,0 +1,60 @@
+#include "catch.hpp"
+
+#include "jump_stack_pool.hpp"
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+SCENARIO("positional access with jump pointers") {
+  jump_stack_pool<int, std::uint32_t> pool;
+  auto l = pool.new_stack();
+  REQUIRE(pool.depth(l) == 0);
+
+  const int n = 1000;
+  for (int i = 0; i < n; ++i)
+    l = pool.push(i, l);
+
+  THEN("depth is the size of the stack") {
+    REQUIRE(pool.depth(l) == n);
+    REQUIRE(pool.depth(pool.next(l)) == n - 1);
+  }
+
+  THEN("at returns the k-th value from the top") {
+    for (int k = 0; k < n; ++k)
+      REQUIRE(pool.at(l, k) == n - 1 - k);
+    REQUIRE_THROWS_AS(pool.at(l, n), std::out_of_range);
+  }
+
+  THEN("drop skips the top values") {
+    REQUIRE(pool.drop(l, 0) == l);
+    REQUIRE(pool.value(pool.drop(l, 10)) == n - 11);
+    REQUIRE(pool.depth(pool.drop(l, 10)) == n - 10);
+    REQUIRE(pool.drop(l, n) == pool.end());
+    REQUIRE(pool.drop(l, n + 5) == pool.end());
+  }
+
+  THEN("values can be modified") {
+    pool.at(l, 3) = -1;
+    REQUIRE(pool.value(pool.drop(l, 3)) == -1);
+  }
+
+  THEN("jump pointers survive pops and pushes on shared nodes") {
+    std::mt19937 gen{7};
+    std::vector<int> mirror;
+    for (int i = 0; i < n; ++i)
+      mirror.push_back(i);
+    for (int i = 0; i < 3000; ++i) {
+      if (gen() % 2 == 0 && !mirror.empty()) {
+        l = pool.pop(l);
+        mirror.pop_back();
+      } else {
+        l = pool.push(i, l);
+        mirror.push_back(i);
+      }
+    }
+    REQUIRE(pool.depth(l) == mirror.size());
+    for (std::size_t k = 0; k < mirror.size(); k += 7)
+      REQUIRE(pool.at(l, k) == mirror[mirror.size() - 1 - k]);
+  }
+}
@@ -0,0 +1,132 @@
+#include "catch.hpp"
+
+#include "../c++/10_efficient_programming/count_operations/instrumented.hpp"
+#include "stack_pool.hpp"
+#include <cstdint>
+#include <vector>
+
+// the exact number of operations done on the values, so that hidden copies
+// (and missing ones) are caught
+
+namespace {
+  using value = instrumented<int>;
+  using base = instrumented_base;
+
+  double count(base::operations op) { return base::counts[op]; }
+
+  // copies and moves, made by constructors or assignments
+  double copies() { return count(base::copy_ctor) + count(base::copy_assign); }
+  double moves() { return count(base::move_ctor) + count(base::move_assign); }
+}  // namespace
+
+SCENARIO("operations on the values of a stack_pool") {
+  const int n = 1000;
+  stack_pool<value, std::uint32_t> pool;
+  pool.reserve(n);
+  auto l = pool.new_stack();
+  const value x{42};
+
+  GIVEN("a pool without free nodes") {
+    base::initialize(n);
+    for (int i = 0; i < n; ++i)
+      l = pool.push(x, l);
+
+    THEN("push default constructs and copies each value once") {
+      REQUIRE(count(base::default_ctor) == n);
+      REQUIRE(count(base::copy_assign) == n);
+      REQUIRE(count(base::copy_ctor) == 0);
+      REQUIRE(moves() == 0);
+    }
+  }
+
+  GIVEN("a pool with free nodes") {
+    for (int i = 0; i < n; ++i)
+      l = pool.push(x, l);
+    l = pool.free_stack(l);
+
+    THEN("push of an lvalue copies each value once") {
+      base::initialize(n);
+      for (int i = 0; i < n; ++i)
+        l = pool.push(x, l);
+      REQUIRE(count(base::copy_assign) == n);
+      REQUIRE(count(base::copy_ctor) == 0);
+      REQUIRE(moves() == 0);
+      REQUIRE(count(base::default_ctor) == 0);
+    }
+
+    THEN("push of an rvalue moves each value once") {
+      value v{1};
+      base::initialize(n);
+      for (int i = 0; i < n; ++i)
+        l = pool.push(std::move(v), l);
+      REQUIRE(count(base::move_assign) == n);
+      REQUIRE(count(base::move_ctor) == 0);
+      REQUIRE(copies() == 0);
+      REQUIRE(count(base::default_ctor) == 0);
+    }
+
+    THEN("push_all copies each value once") {
+      std::vector<value> v(n, x);
+      base::initialize(n);
+      l = stack_utils::push_all(pool, l, v.begin(), v.end());
+      REQUIRE(count(base::copy_assign) == n);
+      REQUIRE(count(base::copy_ctor) == 0);
+      REQUIRE(moves() == 0);
+      REQUIRE(count(base::default_ctor) == 0);
+    }
+  }
+
+  GIVEN("a stack") {
+    for (int i = 0; i < n; ++i)
+      l = pool.push(value{i}, l);
+    base::initialize(n);
+
+    THEN("pop and free_stack do not touch the values") {
+      for (int i = 0; i < n / 2; ++i)
+        l = pool.pop(l);
+      l = pool.free_stack(l);
+      for (std::size_t op = 1; op < base::n_ops; ++op)
+        REQUIRE(base::counts[op] == 0);
+    }
+
+    THEN("traversals do not touch the values") {
+      long sum = 0;
+      for (auto it = pool.begin(l); it != pool.end(l); ++it)
+        sum += int(*it);
+      for (auto it = pool.cbegin(l); it != pool.cend(l); ++it)
+        sum += int(*it);
+      for (auto it = pool.unchecked_begin(l); it != pool.unchecked_end(l); ++it)
+        sum += int(*it);
+      pool.for_each(l, [&sum](const value& v) { sum += int(v); });
+      REQUIRE(sum == 4L * n * (n - 1) / 2);
+      for (std::size_t op = 1; op < base::n_ops; ++op)
+        REQUIRE(base::counts[op] == 0);
+    }
+
+    THEN("to_vector moves each value once") {
+      auto v = stack_utils::to_vector(pool, l);
+      REQUIRE(v.size() == n);
+      REQUIRE(count(base::move_ctor) == n);
+      REQUIRE(count(base::move_assign) == 0);
+      REQUIRE(copies() == 0);
+      REQUIRE(count(base::default_ctor) == 0);
+    }
+  }
+
+  GIVEN("a pool which grows") {
+    stack_pool<value, std::uint32_t> growing;
+    auto g = growing.new_stack();
+    base::initialize(n);
+    for (int i = 0; i < n; ++i)
+      g = growing.push(x, g);
+
+    THEN("reallocations copy less than two values per push") {
+      // the move constructor of instrumented is not noexcept, therefore
+      // std::vector copies the nodes when it grows (geometrically)
+      REQUIRE(count(base::copy_ctor) < 2 * n);
+      REQUIRE(count(base::copy_assign) == n);
+      REQUIRE(count(base::default_ctor) == n);
+      REQUIRE(moves() == 0);
+    }
+  }
+}
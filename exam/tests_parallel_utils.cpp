@@ -0,0 +1,115 @@
+#include "catch.hpp"
+
+#include "parallel_utils.hpp"
+#include <cstdint>
+#include <functional>  // plus
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+SCENARIO("parallel helpers of stack_utils") {
+  work_stealing_pool tp{4};
+
+  stack_pool<int, std::uint32_t> pool;
+  std::vector<std::uint32_t> heads;
+  for (int s = 0; s < 40; ++s) {
+    auto h = pool.new_stack();
+    for (int i = 0; i < (s % 7) * s; ++i)
+      h = pool.push(i, h);
+    heads.push_back(h);
+  }
+  const auto& cpool = pool;
+
+  THEN("parallel_stack_sizes agrees with stack_size") {
+    auto sizes = stack_utils::parallel_stack_sizes(tp, cpool, heads);
+    REQUIRE(sizes.size() == heads.size());
+    for (std::size_t i = 0; i < heads.size(); ++i)
+      REQUIRE(sizes[i] == stack_utils::stack_size(cpool, heads[i]));
+  }
+
+  THEN("parallel_transform keeps the order of the values") {
+    auto sizes = stack_utils::parallel_stack_sizes(tp, cpool, heads);
+    auto doubled = [](int x) { return 2.0 * x; };
+    auto balanced =
+        stack_utils::parallel_transform(tp, cpool, heads, doubled, sizes);
+    auto stolen = stack_utils::parallel_transform(tp, cpool, heads, doubled);
+    REQUIRE(balanced == stolen);
+    for (std::size_t i = 0; i < heads.size(); ++i) {
+      REQUIRE(balanced[i].size() == sizes[i]);
+      // values are pushed in increasing order, so they are read decreasing
+      for (std::size_t j = 0; j < sizes[i]; ++j)
+        REQUIRE(balanced[i][j] == 2.0 * (sizes[i] - 1 - j));
+    }
+  }
+
+  THEN("parallel_reduce sums all the values") {
+    long expected = 10;
+    for (auto h : heads)
+      for (auto it = cpool.cbegin(h); it != cpool.cend(h); ++it)
+        expected += *it;
+
+    REQUIRE(stack_utils::parallel_reduce(tp, cpool, heads, 10L,
+                                         std::plus<long>{}) == expected);
+    auto sizes = stack_utils::parallel_stack_sizes(tp, cpool, heads);
+    REQUIRE(stack_utils::parallel_reduce(tp, cpool, heads, 10L,
+                                         std::plus<long>{},
+                                         sizes) == expected);
+  }
+
+  THEN("lengths must match the heads") {
+    auto sizes = stack_utils::parallel_stack_sizes(tp, cpool, heads);
+    sizes.pop_back();
+    auto id = [](int x) { return x; };
+    REQUIRE_THROWS_AS(
+        stack_utils::parallel_transform(tp, cpool, heads, id, sizes),
+        std::invalid_argument);
+    REQUIRE_THROWS_AS(stack_utils::parallel_reduce(tp, cpool, heads, 0L,
+                                                   std::plus<long>{}, sizes),
+                      std::invalid_argument);
+  }
+
+  THEN("balanced_partition covers all the heads") {
+    std::vector<std::size_t> lengths{100, 0, 0, 1, 50, 50, 0, 7};
+    auto b = stack_utils::detail::balanced_partition(lengths, 3);
+    REQUIRE(b.front() == 0);
+    REQUIRE(b.back() == lengths.size());
+    REQUIRE(b.size() <= 4);
+    for (std::size_t k = 1; k < b.size(); ++k)
+      REQUIRE(b[k - 1] < b[k]);
+  }
+
+  THEN("parallel_bulk_build agrees with push") {
+    std::vector<std::pair<int, int>> pairs;
+    std::vector<std::uint32_t> pushed(50, pool.end());
+    stack_pool<int, std::uint32_t> serial;
+    for (int i = 0; i < 5000; ++i) {
+      const int s = (i * i + 3 * i) % 47;
+      pairs.emplace_back(s, i);
+      pushed[s] = serial.push(i, pushed[s]);
+    }
+
+    auto built = stack_utils::parallel_bulk_build<int, std::uint32_t>(
+        tp, pairs.begin(), pairs.end(), 50);
+    REQUIRE(built.second.size() == 50);
+    for (std::size_t s = 0; s < 50; ++s) {
+      auto h = built.second[s];
+      REQUIRE(std::vector<int>(built.first.cbegin(h), built.first.cend(h)) ==
+              std::vector<int>(serial.cbegin(pushed[s]),
+                               serial.cend(pushed[s])));
+      // the nodes of a stack are contiguous
+      for (; h != built.first.end() && built.first.next(h) != built.first.end();
+           h = built.first.next(h))
+        REQUIRE(built.first.next(h) == h + 1);
+    }
+    REQUIRE(built.first.count_live() == 5000);
+
+    pairs.emplace_back(50, 0);
+    REQUIRE_THROWS_AS((stack_utils::parallel_bulk_build<int, std::uint32_t>(
+                          tp, pairs.begin(), pairs.end(), 50)),
+                      std::out_of_range);
+
+    auto none = stack_utils::parallel_bulk_build<int, std::uint32_t>(
+        tp, pairs.begin(), pairs.begin(), 3);
+    REQUIRE(none.second == std::vector<std::uint32_t>(3, 0));
+  }
+}
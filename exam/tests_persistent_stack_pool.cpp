@@ -0,0 +1,146 @@
+#include "catch.hpp"
+
+#include "persistent_stack_pool.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+  template <typename P, typename H>
+  std::vector<int> values(const P& pool, H head) {
+    std::vector<int> v;
+    pool.for_each(head, [&v](int x) { v.push_back(x); });
+    return v;
+  }
+}  // namespace
+
+SCENARIO("versions of a persistent stack") {
+  persistent_stack_pool<int, std::uint16_t> pool{16};
+  auto v1 = pool.new_stack();
+  for (int x : {1, 2, 3})
+    v1 = pool.push(x, v1);
+  REQUIRE(pool.count_nodes() == 3);
+
+  GIVEN("two versions sharing a tail") {
+    auto v2 = pool.push(4, pool.copy(v1));
+    auto v3 = pool.push(5, pool.copy(v1));
+    REQUIRE(values(pool, v2) == std::vector<int>{4, 3, 2, 1});
+    REQUIRE(values(pool, v3) == std::vector<int>{5, 3, 2, 1});
+    REQUIRE(pool.count_nodes() == 5);
+    REQUIRE(pool.use_count(v1) == 3);
+
+    THEN("releasing a version keeps the shared nodes") {
+      pool.free_stack(v2);
+      REQUIRE(pool.count_nodes() == 4);
+      REQUIRE(values(pool, v3) == std::vector<int>{5, 3, 2, 1});
+      pool.free_stack(v1);
+      REQUIRE(pool.count_nodes() == 4);
+      REQUIRE(values(pool, v3) == std::vector<int>{5, 3, 2, 1});
+
+      THEN("the last version releases everything") {
+        pool.free_stack(v3);
+        REQUIRE(pool.count_nodes() == 0);
+      }
+    }
+
+    THEN("popping a shared node does not reclaim it") {
+      auto t = pool.pop(v2);
+      REQUIRE(t == v1);
+      REQUIRE(pool.use_count(v1) == 3);
+      REQUIRE(pool.count_nodes() == 4);
+      t = pool.pop(t);
+      REQUIRE(values(pool, t) == std::vector<int>{2, 1});
+      REQUIRE(values(pool, v1) == std::vector<int>{3, 2, 1});
+      REQUIRE(values(pool, v3) == std::vector<int>{5, 3, 2, 1});
+      REQUIRE(pool.count_nodes() == 4);
+    }
+  }
+
+  GIVEN("a copy") {
+    auto c = pool.copy(v1);
+    REQUIRE(c == v1);
+    REQUIRE(pool.use_count(v1) == 2);
+
+    THEN("popping the original leaves the copy intact") {
+      v1 = pool.pop(v1);
+      v1 = pool.pop(v1);
+      v1 = pool.pop(v1);
+      REQUIRE(pool.empty(v1));
+      REQUIRE(values(pool, c) == std::vector<int>{3, 2, 1});
+      REQUIRE(pool.count_nodes() == 3);
+
+      THEN("popping the copy reclaims the nodes") {
+        c = pool.pop(c);
+        REQUIRE(pool.count_nodes() == 2);
+        c = pool.free_stack(c);
+        REQUIRE(pool.count_nodes() == 0);
+        REQUIRE(pool.empty(c));
+      }
+    }
+  }
+
+  GIVEN("reclaimed nodes") {
+    const auto capacity = pool.capacity();
+    pool.free_stack(v1);
+    THEN("they are recycled") {
+      auto l = pool.new_stack();
+      for (int x : {7, 8, 9})
+        l = pool.push(x, l);
+      REQUIRE(pool.capacity() == capacity);
+      REQUIRE(values(pool, l) == std::vector<int>{9, 8, 7});
+    }
+  }
+}
+
+SCENARIO("hash-consing of persistent stacks") {
+  persistent_stack_pool<std::string, std::uint32_t, true> pool;
+  REQUIRE(pool.hash_conses());
+
+  auto build = [&pool](std::vector<std::string> words) {
+    auto l = pool.new_stack();
+    for (auto& w : words)
+      l = pool.push(w, l);
+    return l;
+  };
+
+  auto a = build({"x", "y", "z"});
+  auto b = build({"x", "y", "z"});
+  auto c = build({"x", "y", "w"});
+  REQUIRE(a == b);
+  REQUIRE(pool.next(c) == pool.next(a));
+  REQUIRE(pool.count_nodes() == 4);
+
+  THEN("deduplicated nodes are released when not referenced") {
+    pool.free_stack(a);
+    REQUIRE(pool.count_nodes() == 4);
+    pool.free_stack(b);
+    REQUIRE(pool.count_nodes() == 3);
+    pool.free_stack(c);
+    REQUIRE(pool.count_nodes() == 0);
+
+    THEN("released nodes are not found anymore") {
+      auto d = build({"x"});
+      REQUIRE(pool.value(d) == "x");
+      REQUIRE(pool.count_nodes() == 1);
+    }
+  }
+}
+
+namespace {
+  // no std::hash and no operator==
+  struct point {
+    int x, y;
+  };
+}  // namespace
+
+SCENARIO("persistent stacks of values which cannot be hashed") {
+  persistent_stack_pool<point, std::uint32_t> pool;
+  REQUIRE_FALSE(pool.hash_conses());
+  auto a = pool.push(point{1, 2}, pool.new_stack());
+  auto b = pool.push(point{1, 2}, pool.copy(a));
+  REQUIRE(pool.next(b) == a);
+  REQUIRE(pool.value(b).y == 2);
+  pool.free_stack(a);
+  pool.free_stack(b);
+  REQUIRE(pool.count_nodes() == 0);
+}
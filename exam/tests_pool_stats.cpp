@@ -0,0 +1,113 @@
+#include "catch.hpp"
+
+#include "pool_stats.hpp"
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+SCENARIO("statistics of a pool") {
+  stack_pool<std::int64_t, std::uint32_t> pool;
+  std::vector<std::uint32_t> heads(4, pool.end());
+  for (int i = 0; i < 10; ++i)
+    heads[i % 2] = pool.push(i, heads[i % 2]);
+  heads[2] = pool.push(42, heads[2]);
+  // free nodes 6, 8 and 10 (the top of heads[1]), and 11 (heads[2])
+  for (int i = 0; i < 3; ++i)
+    heads[1] = pool.pop(heads[1]);
+  heads[2] = pool.free_stack(heads[2]);
+
+  auto s = pool.stats();
+
+  THEN("nodes are classified") {
+    REQUIRE(s.nodes == 11);
+    REQUIRE(s.live_nodes == 7);
+    REQUIRE(s.free_nodes == 4);
+    REQUIRE(s.largest_free_run == 2);
+    REQUIRE(s.fragmentation == Approx(0.5));
+    REQUIRE(s.bytes_used == 7 * (s.bytes_reserved / pool.capacity()));
+    REQUIRE(s.bytes_reserved >= pool.capacity() * sizeof(std::int64_t));
+  }
+
+  THEN("the liveness bitmap gives the same result") {
+    pool.track_liveness(true);
+    auto t = pool.stats();
+    REQUIRE(t.live_nodes == s.live_nodes);
+    REQUIRE(t.largest_free_run == s.largest_free_run);
+  }
+
+  THEN("contiguous free nodes are not fragmented") {
+    heads[0] = pool.free_stack(heads[0]);
+    heads[1] = pool.free_stack(heads[1]);
+    auto t = pool.stats();
+    REQUIRE(t.live_nodes == 0);
+    REQUIRE(t.largest_free_run == 11);
+    REQUIRE(t.fragmentation == 0.0);
+  }
+
+  THEN("events are not counted by default") {
+    REQUIRE_FALSE(pool.counts_events());
+    REQUIRE_FALSE(s.counts_events);
+    REQUIRE(s.pushes == 0);
+  }
+
+  THEN("the histogram buckets the lengths by powers of 2") {
+    auto h = stack_utils::stack_length_histogram(pool, heads);
+    // lengths 5, 2, 0 and 0
+    REQUIRE(h == std::vector<std::size_t>{2, 0, 1, 1});
+  }
+
+  THEN("everything is written as JSON") {
+    std::ostringstream os;
+    stack_utils::write_json(os, s, {2, 0, 1, 1});
+    const std::string json = os.str();
+    REQUIRE(json.front() == '{');
+    REQUIRE(json.back() == '}');
+    REQUIRE(json.find("\"live_nodes\": 7") != std::string::npos);
+    REQUIRE(json.find("\"length_histogram\": [2, 0, 1, 1]") !=
+            std::string::npos);
+    REQUIRE(json.find("\"events\": null") != std::string::npos);
+  }
+}
+
+SCENARIO("event counters of a pool") {
+  stack_pool<std::int64_t, std::uint32_t> pool;
+  pool.count_events(true);
+  REQUIRE(pool.counts_events());
+  std::uint32_t h = pool.end();
+  for (int i = 0; i < 10; ++i)
+    h = pool.push(i, h);
+  for (int i = 0; i < 3; ++i)
+    h = pool.pop(h);
+  h = pool.free_stack(h);
+
+  auto s = pool.stats();
+  REQUIRE(s.counts_events);
+  REQUIRE(s.pushes == 10);
+  REQUIRE(s.pops == 3);
+  REQUIRE(s.free_stacks == 1);
+  REQUIRE(s.reallocations >= 1);
+
+  THEN("disabling the counters keeps the counts") {
+    pool.count_events(false);
+    h = pool.push(1, h);
+    auto t = pool.stats();
+    REQUIRE_FALSE(t.counts_events);
+    REQUIRE(t.pushes == 10);
+  }
+
+  THEN("merged pools add their counts") {
+    stack_pool<std::int64_t, std::uint32_t> other;
+    other.count_events(true);
+    other.push(1, other.end());
+    pool.merge_from(std::move(other));
+    REQUIRE(pool.stats().pushes == 11);
+  }
+
+  THEN("the counts are written as JSON") {
+    std::ostringstream os;
+    stack_utils::write_json(os, s, {});
+    REQUIRE(os.str().find("\"pushes\": 10") != std::string::npos);
+  }
+}
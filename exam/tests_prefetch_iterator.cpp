@@ -0,0 +1,59 @@
+#include "catch.hpp"
+
+#include "prefetch_iterator.hpp"
+#include <algorithm>  // max_element
+#include <cstdint>
+#include <vector>
+
+SCENARIO("using prefetching iterators") {
+  stack_pool<int, std::uint16_t> pool;
+  auto l1 = pool.new_stack();
+  auto l2 = pool.new_stack();
+  for (int i = 0; i < 20; ++i) {
+    l1 = pool.push(i, l1);
+    l2 = pool.push(100 - i, l2);
+  }
+
+  THEN("they visit the same values as the usual iterators") {
+    std::vector<int> expected(pool.begin(l1), pool.end(l1));
+    std::vector<int> visited(stack_utils::prefetch_begin(pool, l1),
+                             stack_utils::prefetch_end(pool, l1));
+    REQUIRE(visited == expected);
+    auto single = pool.push(7, pool.new_stack());
+    REQUIRE(std::vector<int>(stack_utils::prefetch_begin(pool, single),
+                             stack_utils::prefetch_end(pool, single)) ==
+            std::vector<int>{7});
+  }
+
+  THEN("they work with std algorithms") {
+    const auto& cpool = pool;
+    auto m = std::max_element(stack_utils::prefetch_begin(cpool, l2),
+                              stack_utils::prefetch_end(cpool, l2));
+    REQUIRE(*m == 100);
+    REQUIRE(m.ptr_to_stack() == 2);
+  }
+
+  THEN("values can be modified") {
+    for (auto it = stack_utils::prefetch_begin(pool, l1);
+         it != stack_utils::prefetch_end(pool, l1); ++it)
+      *it = -*it;
+    REQUIRE(pool.value(l1) == -19);
+  }
+
+  THEN("a visit inside a checkpoint does not grow the undo log") {
+    pool.checkpoint();
+    int sum = 0;
+    for (auto it = stack_utils::prefetch_begin(pool, l1);
+         it != stack_utils::prefetch_end(pool, l1); ++it)
+      sum += *it;
+    REQUIRE(sum == 190);
+    REQUIRE(pool.undo_log_size() == 0);
+    pool.rollback();
+  }
+
+  THEN("empty stacks have no values") {
+    auto empty = pool.new_stack();
+    REQUIRE(stack_utils::prefetch_begin(pool, empty) ==
+            stack_utils::prefetch_end(pool, empty));
+  }
+}
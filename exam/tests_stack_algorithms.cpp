@@ -0,0 +1,136 @@
+#include "catch.hpp"
+
+#include "stack_algorithms.hpp"
+#include <algorithm>  // stable_sort, stable_partition
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+  template <typename P, typename H>
+  auto values(const P& pool, H head) {
+    std::vector<typename std::decay_t<decltype(pool.value(head))>> v;
+    pool.for_each(head, [&v](const auto& x) { v.push_back(x); });
+    return v;
+  }
+
+  // the address of the value held by each node, from top to bottom
+  template <typename P, typename H>
+  auto addresses(const P& pool, H head) {
+    std::vector<const void*> v;
+    pool.for_each(head, [&v](const auto& x) { v.push_back(&x); });
+    return v;
+  }
+}  // namespace
+
+SCENARIO("relinking algorithms") {
+  stack_pool<int, std::uint16_t> pool{64};
+  auto l = pool.new_stack();
+
+  GIVEN("empty stacks") {
+    REQUIRE(stack_utils::reverse_stack(pool, l) == pool.end());
+    REQUIRE(stack_utils::sort_stack(pool, l) == pool.end());
+    REQUIRE(stack_utils::merge_stacks(pool, l, l) == pool.end());
+    auto p = stack_utils::partition_stack(pool, l, [](int) { return true; });
+    REQUIRE(p.first == pool.end());
+    REQUIRE(p.second == pool.end());
+  }
+
+  GIVEN("a stack") {
+    for (int x : {3, 1, 4, 1, 5, 9, 2, 6})
+      l = pool.push(x, l);
+    const auto before = values(pool, l);
+    const auto nodes = addresses(pool, l);
+    const auto capacity = pool.capacity();
+
+    THEN("reverse relinks the nodes") {
+      l = stack_utils::reverse_stack(pool, l);
+      REQUIRE(values(pool, l) ==
+              std::vector<int>(before.rbegin(), before.rend()));
+      REQUIRE(addresses(pool, l) ==
+              std::vector<const void*>(nodes.rbegin(), nodes.rend()));
+      REQUIRE(pool.capacity() == capacity);
+    }
+
+    THEN("sort relinks the nodes") {
+      l = stack_utils::sort_stack(pool, l);
+      REQUIRE(values(pool, l) == std::vector<int>{1, 1, 2, 3, 4, 5, 6, 9});
+      auto after = addresses(pool, l);
+      std::sort(after.begin(), after.end());
+      auto sorted_nodes = nodes;
+      std::sort(sorted_nodes.begin(), sorted_nodes.end());
+      REQUIRE(after == sorted_nodes);
+      REQUIRE(pool.capacity() == capacity);
+
+      THEN("the pool works as before") {
+        l = pool.pop(l);
+        l = pool.push(7, l);
+        REQUIRE(pool.value(l) == 7);
+        REQUIRE(pool.capacity() == capacity);
+      }
+    }
+
+    THEN("sort takes a comparison") {
+      l = stack_utils::sort_stack(pool, l, [](int a, int b) { return a > b; });
+      REQUIRE(values(pool, l) == std::vector<int>{9, 6, 5, 4, 3, 2, 1, 1});
+    }
+
+    THEN("partition puts the selected values on top") {
+      auto p =
+          stack_utils::partition_stack(pool, l, [](int x) { return x % 2; });
+      REQUIRE(values(pool, p.first) ==
+              std::vector<int>{9, 5, 1, 1, 3, 6, 2, 4});
+      REQUIRE(values(pool, p.second) == std::vector<int>{6, 2, 4});
+    }
+  }
+
+  GIVEN("two sorted stacks") {
+    auto a = pool.new_stack();
+    auto b = pool.new_stack();
+    for (int x : {9, 5, 3, 1})
+      a = pool.push(x, a);
+    for (int x : {8, 5, 2})
+      b = pool.push(x, b);
+
+    THEN("merge returns a sorted stack") {
+      l = stack_utils::merge_stacks(pool, a, b);
+      REQUIRE(values(pool, l) == std::vector<int>{1, 2, 3, 5, 5, 8, 9});
+    }
+
+    THEN("equal values coming from the first stack come first") {
+      auto five_a = pool.next(pool.next(a));
+      l = stack_utils::merge_stacks(pool, a, b);
+      REQUIRE(pool.next(pool.next(pool.next(l))) == five_a);
+    }
+  }
+}
+
+SCENARIO("relinking algorithms are stable") {
+  using item = std::pair<int, int>;
+  auto by_key = [](const item& a, const item& b) { return a.first < b.first; };
+  auto odd_key = [](const item& a) { return a.first % 2 == 1; };
+
+  std::mt19937 gen{7};
+  for (std::size_t n : {1, 2, 3, 31, 32, 33, 1000}) {
+    stack_pool<item, std::uint32_t> pool;
+    auto l = pool.new_stack();
+    for (std::size_t i = 0; i < n; ++i)
+      l = pool.push(item{int(gen() % 10), int(i)}, l);
+    auto expected = values(pool, l);
+
+    auto sorted = stack_utils::sort_stack(pool, l, by_key);
+    std::stable_sort(expected.begin(), expected.end(), by_key);
+    REQUIRE(values(pool, sorted) == expected);
+
+    auto p = stack_utils::partition_stack(pool, sorted, odd_key);
+    std::stable_partition(expected.begin(), expected.end(), odd_key);
+    REQUIRE(values(pool, p.first) == expected);
+    auto first_even = std::find_if_not(expected.begin(), expected.end(),
+                                       odd_key);
+    REQUIRE(values(pool, p.second) ==
+            std::vector<item>(first_even, expected.end()));
+
+    REQUIRE(stack_utils::stack_size(pool, p.first) == n);
+  }
+}
@@ -0,0 +1,97 @@
+#include "catch.hpp"
+
+#include "stack_archive.hpp"
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+  template <typename T, typename N>
+  std::vector<std::vector<T>> contents(const stack_pool<T, N>& pool,
+                                       const std::vector<N>& heads) {
+    std::vector<std::vector<T>> v;
+    for (auto h : heads)
+      v.emplace_back(pool.cbegin(h), pool.cend(h));
+    return v;
+  }
+}  // namespace
+
+SCENARIO("archiving stacks of integers") {
+  using limits = std::numeric_limits<std::int64_t>;
+  stack_pool<std::int64_t, std::uint32_t> pool;
+  std::vector<std::uint32_t> heads(4, pool.end());
+  for (std::int64_t i = 0; i < 1000; ++i)
+    heads[0] = pool.push(1000000 + 3 * i, heads[0]);
+  for (std::int64_t x : {limits::min(), limits::max(), std::int64_t(-1),
+                         limits::min(), std::int64_t(0), limits::max()})
+    heads[1] = pool.push(x, heads[1]);
+  for (std::int64_t i = 0; i < 50; ++i)
+    heads[3] = pool.push((i * 7919) % 101 - 50, heads[3]);
+
+  for (std::size_t block_values : {1, 3, 256}) {
+    std::stringstream ss;
+    stack_utils::write_archive(ss, pool, heads, block_values);
+    const std::string archive = ss.str();
+
+    stack_pool<std::int64_t, std::uint16_t> other;
+    auto l = other.push(42, other.new_stack());
+    auto read = stack_utils::read_archive(ss, other);
+    REQUIRE(contents(other, read) == contents(pool, heads));
+    REQUIRE(other.empty(read[2]));
+    REQUIRE(other.value(l) == 42);
+
+    // every strict prefix is detected
+    for (std::size_t n = 0; n < archive.size(); n += 1 + n / 8) {
+      std::stringstream truncated{archive.substr(0, n)};
+      REQUIRE_THROWS_AS(stack_utils::read_archive(truncated, other),
+                        std::runtime_error);
+    }
+  }
+
+  THEN("sorted stacks take about a byte per value") {
+    std::stringstream ss;
+    stack_utils::write_archive(ss, pool, std::vector<std::uint32_t>{heads[0]});
+    REQUIRE(ss.str().size() < 1000 + 30);
+  }
+
+  THEN("frozen stacks give the same archive") {
+    std::stringstream a, b;
+    stack_utils::write_archive(a, pool, heads, 16);
+    stack_utils::write_archive(b, stack_utils::freeze(pool, heads), 16);
+    REQUIRE(a.str() == b.str());
+  }
+
+  THEN("differences wrap around for small types") {
+    stack_pool<std::uint8_t, std::uint32_t> bytes;
+    std::vector<std::uint32_t> h{bytes.end()};
+    for (int x : {0, 255, 1, 128, 127})
+      h[0] = bytes.push(std::uint8_t(x), h[0]);
+    std::stringstream ss;
+    stack_utils::write_archive(ss, bytes, h);
+    auto read = stack_utils::read_archive(ss, bytes);
+    REQUIRE(contents(bytes, read) == contents(bytes, h));
+  }
+
+  THEN("invalid archives are rejected") {
+    std::stringstream ss{"psarch2\n\x01\x01\x01\x01\x00"};
+    REQUIRE_THROWS_AS(stack_utils::read_archive(ss, pool),
+                      std::runtime_error);
+    // a block holding more values than the stack
+    const char bytes[] = "psarch1\n\x02\x01\x01\x02\x00\x00";
+    std::stringstream extra{std::string(bytes, sizeof(bytes) - 1)};
+    REQUIRE_THROWS_AS(stack_utils::read_archive(extra, pool),
+                      std::runtime_error);
+    std::stringstream out;
+    REQUIRE_THROWS_AS(stack_utils::write_archive(out, pool, heads, 0),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(
+        stack_utils::write_archive(out, pool, heads, (1 << 24) + 1),
+        std::invalid_argument);
+    REQUIRE_THROWS_AS(stack_utils::write_archive(
+                          out, stack_utils::freeze(pool, heads), 0),
+                      std::invalid_argument);
+  }
+}
@@ -0,0 +1,148 @@
+#include "catch.hpp"
+
+#include "stack_ingest.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+  const char* const path = "tests_stack_ingest.tmp";
+
+  void write_file(const std::string& content) {
+    std::ofstream{path, std::ios::binary} << content;
+  }
+
+  template <typename T, typename N>
+  std::vector<T> values(const stack_pool<T, N>& pool, N head) {
+    return std::vector<T>(pool.cbegin(head), pool.cend(head));
+  }
+}  // namespace
+
+SCENARIO("ingesting stacks from files") {
+  work_stealing_pool tp{3};
+  stack_pool<std::int64_t, std::uint32_t> pool;
+  auto l = pool.push(-1, pool.new_stack());
+
+  GIVEN("a text file") {
+    write_file("2\t10\n0\t-5\r\n\n2\t30\n2\t20");
+    auto heads = stack_utils::ingest_text(tp, path, pool);
+
+    THEN("the stacks are appended to the pool") {
+      REQUIRE(heads.size() == 3);
+      REQUIRE(values(pool, heads[0]) == std::vector<std::int64_t>{-5});
+      REQUIRE(pool.empty(heads[1]));
+      REQUIRE(values(pool, heads[2]) == std::vector<std::int64_t>{20, 30, 10});
+      REQUIRE(values(pool, l) == std::vector<std::int64_t>{-1});
+    }
+  }
+
+  GIVEN("a large text file") {
+    std::string content;
+    std::vector<std::vector<double>> expected(100);
+    for (int i = 0; i < 200000; ++i) {
+      content += std::to_string(i % 100) + '\t' + std::to_string(i) + ".5\n";
+      expected[i % 100].insert(expected[i % 100].begin(), i + 0.5);
+    }
+    write_file(content);
+    stack_pool<double, std::uint32_t> doubles;
+    auto heads = stack_utils::ingest_text(tp, path, doubles);
+
+    THEN("the parts read by the threads are joined in order") {
+      REQUIRE(heads.size() == 100);
+      for (std::size_t s = 0; s < 100; ++s)
+        REQUIRE(values(doubles, heads[s]) == expected[s]);
+    }
+  }
+
+  GIVEN("malformed text files") {
+    for (const char* bad : {"1\t2\n3 4\n", "1\t\n", "x\t1\n", "1\t2x\n",
+                            "-1\t2\n", "99999999999\t2\n"}) {
+      write_file(bad);
+      REQUIRE_THROWS_AS(stack_utils::ingest_text(tp, path, pool),
+                        std::runtime_error);
+    }
+    REQUIRE(pool.count_live() == 1);
+    REQUIRE(values(pool, l) == std::vector<std::int64_t>{-1});
+  }
+
+  GIVEN("floating point values not accepted by std::from_chars") {
+    stack_pool<double, std::uint32_t> doubles;
+    for (const char* bad : {"0\t 1.5\n", "0\t+1.5\n", "0\t0x1p3\n",
+                            "0\tinf\n", "0\tnan\n", "0\t1e999\n"}) {
+      write_file(bad);
+      REQUIRE_THROWS_AS(stack_utils::ingest_text(tp, path, doubles),
+                        std::runtime_error);
+    }
+    write_file("0\t-.5\n0\t1e3\n");
+    auto heads = stack_utils::ingest_text(tp, path, doubles);
+    REQUIRE(values(doubles, heads[0]) == std::vector<double>{1000, -0.5});
+  }
+
+  GIVEN("floating point values longer than 64 characters") {
+    stack_pool<double, std::uint32_t> doubles;
+    const std::string one = "1." + std::string(100, '0') + "1";
+    const std::string big = "2" + std::string(99, '0') + ".5e-99";
+    write_file("0\t" + one + "\n0\t" + big + "\n");
+    auto heads = stack_utils::ingest_text(tp, path, doubles);
+    auto v = values(doubles, heads[0]);
+    REQUIRE(v.size() == 2);
+    REQUIRE(v[0] == Approx(2.0));
+    REQUIRE(v[1] == 1.0);
+  }
+
+  GIVEN("stack ids which are too large") {
+    write_file("0\t1\n4000000000\t2\n");
+    REQUIRE_THROWS_AS(stack_utils::ingest_text(tp, path, pool),
+                      std::runtime_error);
+    write_file("0\t1\n10\t2\n");
+    REQUIRE_THROWS_AS(stack_utils::ingest_text(tp, path, pool, 10),
+                      std::runtime_error);
+    REQUIRE(stack_utils::ingest_text(tp, path, pool, 11).size() == 11);
+  }
+
+  GIVEN("a checkpoint") {
+    pool.checkpoint();
+    write_file("1\t10\n1\t20\n");
+    auto heads = stack_utils::ingest_text(tp, path, pool);
+    REQUIRE(values(pool, heads[1]) == std::vector<std::int64_t>{20, 10});
+    REQUIRE(pool.undo_log_size() == 0);
+    pool.rollback();
+    REQUIRE(pool.count_live() == 1);
+  }
+
+  GIVEN("a binary file") {
+    std::string content;
+    for (std::uint32_t i = 0; i < 1000; ++i) {
+      const std::uint32_t id = i % 7;
+      const std::int64_t value = i;
+      content.append(reinterpret_cast<const char*>(&id), sizeof(id));
+      content.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    write_file(content);
+    auto heads = stack_utils::ingest_binary(tp, path, pool);
+    REQUIRE(heads.size() == 7);
+    REQUIRE(pool.value(heads[3]) == 997);
+    REQUIRE(stack_utils::stack_size(pool, heads[3]) == 143);
+    REQUIRE(pool.count_live() == 1001);
+
+    write_file(content.substr(1));
+    REQUIRE_THROWS_AS(stack_utils::ingest_binary(tp, path, pool),
+                      std::runtime_error);
+    write_file(content);
+    REQUIRE_THROWS_AS(stack_utils::ingest_binary(tp, path, pool, 6),
+                      std::runtime_error);
+  }
+
+  GIVEN("an empty file") {
+    write_file("");
+    REQUIRE(stack_utils::ingest_text(tp, path, pool).empty());
+    REQUIRE(stack_utils::ingest_binary(tp, path, pool).empty());
+  }
+
+  std::remove(path);
+  REQUIRE_THROWS_AS(stack_utils::ingest_text(tp, path, pool),
+                    std::system_error);
+}
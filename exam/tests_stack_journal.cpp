@@ -0,0 +1,222 @@
+#include "catch.hpp"
+
+#include "stack_journal.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+  const std::string journal_path = "tests_stack_journal.tmp";
+
+  // commits are made by commit() only
+  const journal_options manual{std::chrono::microseconds{0}, false};
+
+  using pool_type = journaled_stack_pool<int, std::uint32_t>;
+
+  std::vector<int> contents(const pool_type& p, std::size_t slot) {
+    const auto& pool = p.underlying();
+    return std::vector<int>(pool.cbegin(p.head(slot)),
+                            pool.cend(p.head(slot)));
+  }
+
+  std::size_t file_size(const std::string& path) {
+    std::ifstream in{path, std::ios::binary | std::ios::ate};
+    return std::size_t(in.tellg());
+  }
+}  // namespace
+
+SCENARIO("saving and loading a stack pool") {
+  stack_pool<int, std::uint16_t> pool;
+  auto l1 = pool.new_stack();
+  for (int i = 0; i < 10; ++i)
+    l1 = pool.push(i, l1);
+  auto l2 = pool.push(42, pool.new_stack());
+  l1 = pool.pop(pool.pop(l1));
+
+  std::stringstream ss;
+  pool.save(ss);
+  const std::string saved = ss.str();
+  auto loaded = stack_pool<int, std::uint16_t>::load(ss);
+  REQUIRE(std::vector<int>(loaded.cbegin(l1), loaded.cend(l1)) ==
+          std::vector<int>{7, 6, 5, 4, 3, 2, 1, 0});
+  REQUIRE(loaded.value(l2) == 42);
+
+  THEN("the free nodes are reused") {
+    REQUIRE(loaded.push(1, loaded.new_stack()) == pool.push(1, l2));
+  }
+
+  THEN("another type or a truncated stream is rejected") {
+    std::stringstream other{saved};
+    REQUIRE_THROWS_AS((stack_pool<int, std::uint32_t>::load(other)),
+                      std::runtime_error);
+    std::stringstream truncated{saved.substr(0, saved.size() - 1)};
+    REQUIRE_THROWS_AS((stack_pool<int, std::uint16_t>::load(truncated)),
+                      std::runtime_error);
+  }
+
+  THEN("a corrupted size fails on the truncated stream") {
+    stack_pool<int, std::size_t> big;
+    big.push(1, big.new_stack());
+    std::stringstream os;
+    big.save(os);
+    std::string bytes = os.str();
+    // the number of nodes, in the header
+    const std::uint64_t huge = std::uint64_t(1) << 60;
+    bytes.replace(3 * sizeof(std::uint64_t), sizeof(huge),
+                  reinterpret_cast<const char*>(&huge), sizeof(huge));
+    std::stringstream is{bytes};
+    REQUIRE_THROWS_AS((stack_pool<int, std::size_t>::load(is)),
+                      std::runtime_error);
+  }
+
+  THEN("a pool with a checkpoint cannot be saved") {
+    pool.checkpoint();
+    REQUIRE_THROWS_AS(pool.save(ss), std::logic_error);
+  }
+}
+
+SCENARIO("recovering a pool from its journal") {
+  std::remove(journal_path.c_str());
+  std::vector<int> expected0, expected2;
+  std::size_t first_frame = 0;
+  {
+    stack_journal j{journal_path, manual};
+    pool_type p{j, 7};
+    for (int i = 0; i < 100; ++i) {
+      p.push(0, i);
+      p.push(2, -i);
+    }
+    p.pop(0);
+    p.free_stack(2);
+    p.push(2, 5);
+    j.commit();
+    REQUIRE(j.commits() == 1);
+    first_frame = file_size(journal_path);
+    expected0 = contents(p, 0);
+    expected2 = contents(p, 2);
+
+    // not committed, hence lost by the "crash"
+    p.push(0, 1000);
+  }
+  // the destructor commits what is left: drop it as a crash would
+  {
+    std::ifstream in{journal_path, std::ios::binary};
+    REQUIRE(stack_utils::read_journal(in, [](const auto&) {}) ==
+            file_size(journal_path));
+    REQUIRE(first_frame < file_size(journal_path));
+    std::ifstream whole{journal_path, std::ios::binary};
+    std::string bytes{std::istreambuf_iterator<char>{whole}, {}};
+    std::ofstream out{journal_path, std::ios::binary | std::ios::trunc};
+    out.write(bytes.data(), std::streamsize(first_frame) + 5);
+  }
+
+  stack_journal j{journal_path, manual};
+  THEN("a torn frame is truncated") {
+    REQUIRE(file_size(journal_path) == first_frame);
+  }
+
+  auto p = pool_type::recover(j, 7, journal_path);
+  REQUIRE(contents(p, 0) == expected0);
+  REQUIRE(p.underlying().empty(p.head(1)));
+  REQUIRE(contents(p, 2) == expected2);
+  REQUIRE(p.lsn() == 203);
+
+  THEN("other streams are ignored") {
+    auto other = pool_type::recover(j, 8, journal_path);
+    REQUIRE(other.slots() == 0);
+    REQUIRE(other.lsn() == 0);
+  }
+
+  THEN("the pool can be recovered from a snapshot and the journal") {
+    std::stringstream snapshot;
+    p.snapshot(snapshot);
+    p.push(1, 11);
+    p.pop(0);
+    pool_type q{j, 8};
+    q.push(0, 3);
+    j.commit();
+    auto r = pool_type::recover(j, 7, journal_path, &snapshot);
+    REQUIRE(r.lsn() == p.lsn());
+    for (std::size_t slot = 0; slot < 3; ++slot)
+      REQUIRE(contents(r, slot) == contents(p, slot));
+    // the nodes are the same, hence the free nodes too
+    REQUIRE(r.underlying().stats().free_nodes ==
+            p.underlying().stats().free_nodes);
+    std::stringstream bad{"not a snapshot"};
+    REQUIRE_THROWS_AS(pool_type::recover(j, 7, journal_path, &bad),
+                      std::runtime_error);
+
+    // the number of heads, in the header
+    std::string bytes = snapshot.str();
+    const std::uint64_t huge = std::uint64_t(1) << 60;
+    bytes.replace(2 * sizeof(std::uint64_t), sizeof(huge),
+                  reinterpret_cast<const char*>(&huge), sizeof(huge));
+    std::stringstream corrupted{bytes};
+    REQUIRE_THROWS_AS(pool_type::recover(j, 7, journal_path, &corrupted),
+                      std::runtime_error);
+  }
+
+  THEN("an unknown operation is rejected") {
+    j.add_writer()->append(7, 42, p.lsn() + 1, 0, nullptr, 0);
+    j.commit();
+    REQUIRE_THROWS_AS(pool_type::recover(j, 7, journal_path),
+                      std::runtime_error);
+  }
+
+  THEN("popping an empty stack is not recorded") {
+    REQUIRE_THROWS(p.pop(5));
+    j.commit();
+    auto r = pool_type::recover(j, 7, journal_path);
+    REQUIRE(r.lsn() == p.lsn());
+  }
+}
+
+SCENARIO("a journal whose write fails") {
+  // every write to /dev/full fails with ENOSPC
+  stack_journal j{"/dev/full", manual};
+  pool_type p{j, 1};
+  p.push(0, 1);
+  p.push(0, 2);
+  REQUIRE_THROWS_AS(j.commit(), std::system_error);
+  REQUIRE(j.poisoned_by_error());
+
+  THEN("later commits fail without writing") {
+    REQUIRE_THROWS_AS(j.commit(), std::system_error);
+    REQUIRE(j.commits() == 0);
+  }
+
+  THEN("operations fail before changing the pool") {
+    REQUIRE_THROWS_AS(p.push(0, 3), std::runtime_error);
+    REQUIRE_THROWS_AS(p.pop(0), std::runtime_error);
+    REQUIRE(contents(p, 0) == std::vector<int>{2, 1});
+    REQUIRE(p.lsn() == 2);
+  }
+}
+
+SCENARIO("committing a journal in the background") {
+  std::remove(journal_path.c_str());
+  {
+    stack_journal j{journal_path,
+                    journal_options{std::chrono::microseconds{100}, true}};
+    pool_type p1{j, 1}, p2{j, 2};
+    for (int i = 0; i < 1000; ++i) {
+      p1.push(0, i);
+      p2.push(i % 3, i);
+    }
+    j.commit();
+    REQUIRE(j.commits() >= 1);
+  }
+  stack_journal j{journal_path, manual};
+  auto p1 = pool_type::recover(j, 1, journal_path);
+  auto p2 = pool_type::recover(j, 2, journal_path);
+  REQUIRE(contents(p1, 0).size() == 1000);
+  REQUIRE(contents(p1, 0).front() == 999);
+  REQUIRE(contents(p2, 1).size() == 333);
+  REQUIRE(p2.lsn() == 1000);
+  std::remove(journal_path.c_str());
+}
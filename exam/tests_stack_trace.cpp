@@ -0,0 +1,133 @@
+#include "catch.hpp"
+
+#include "stack_trace.hpp"
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+  template <typename P, typename H>
+  std::vector<std::size_t> sizes(const P& pool, const std::vector<H>& heads) {
+    std::vector<std::size_t> v;
+    for (auto h : heads) {
+      std::size_t n = 0;
+      pool.for_each(h, [&n](const auto&) { ++n; });
+      v.push_back(n);
+    }
+    return v;
+  }
+}  // namespace
+
+SCENARIO("recording and replaying a trace") {
+  recording_stack_pool<std::string, std::uint16_t> pool;
+  trace_buffer trace{1000};
+
+  // not recorded
+  auto l0 = pool.push("ignored", pool.new_stack());
+  pool.free_stack(l0);
+
+  pool.record_to(&trace);
+  std::vector<std::uint16_t> heads(3, pool.end());
+  for (int i = 0; i < 30; ++i)
+    heads[i % 3] = pool.push(std::string(i, 'x'), heads[i % 3]);
+  heads[0] = pool.pop(heads[0]);
+  heads[0] = pool.pop(heads[0]);
+  heads[1] = pool.free_stack(heads[1]);
+  heads[1] = pool.push("abc", heads[1]);
+  pool.record_to(nullptr);
+  pool.push("not recorded either", heads[2]);
+
+  auto records = trace.records();
+  REQUIRE(records.size() == 34);
+  REQUIRE(trace.dropped() == 0);
+  REQUIRE(records[5].op == trace_record::push);
+  REQUIRE(records[5].value_size == 5);
+  REQUIRE(records[30].op == trace_record::pop);
+  REQUIRE(records[32].op == trace_record::free_stack);
+  REQUIRE(records[33].value_size == 3);
+
+  THEN("a replay on another kind of pool builds the same stacks") {
+    stack_pool<std::int64_t, std::uint64_t> other;
+    auto skipped = stack_utils::replay(
+        records, other, [](std::uint32_t size) { return std::int64_t(size); });
+    REQUIRE(skipped == 0);
+
+    // the recorded heads are the same, since both pools start empty
+    REQUIRE(sizes(other, std::vector<std::uint64_t>(heads.begin(),
+                                                    heads.end())) ==
+            std::vector<std::size_t>{8, 1, 10});
+    REQUIRE(other.value(heads[1]) == 3);
+  }
+
+  THEN("latencies are measured") {
+    stack_pool<std::string, std::uint32_t> other;
+    std::vector<double> latencies;
+    stack_utils::replay(
+        records, other,
+        [](std::uint32_t size) { return std::string(size, 'y'); }, &latencies);
+    REQUIRE(latencies.size() == records.size());
+  }
+
+  THEN("a trace can be saved and loaded") {
+    std::stringstream ss;
+    trace.write(ss);
+    auto loaded = trace_buffer::read(ss);
+    REQUIRE(loaded.size() == records.size());
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      REQUIRE(loaded[i].head == records[i].head);
+      REQUIRE(loaded[i].result == records[i].result);
+      REQUIRE(loaded[i].value_size == records[i].value_size);
+      REQUIRE(loaded[i].op == records[i].op);
+    }
+    // 16 bytes of header, 21 bytes per record without padding
+    REQUIRE(ss.str().size() == 16 + 21 * records.size());
+
+    std::string bad_op = ss.str();
+    bad_op[16 + 20] = 7;
+    std::stringstream corrupted_op{bad_op};
+    REQUIRE_THROWS_AS(trace_buffer::read(corrupted_op), std::runtime_error);
+
+    std::stringstream garbage{"not a trace at all"};
+    REQUIRE_THROWS_AS(trace_buffer::read(garbage), std::runtime_error);
+
+    // a huge count of records is not allocated
+    std::string huge = ss.str();
+    const std::uint64_t count = std::uint64_t(1) << 60;
+    huge.replace(sizeof(std::uint64_t), sizeof(count),
+                 reinterpret_cast<const char*>(&count), sizeof(count));
+    std::stringstream corrupted{huge};
+    REQUIRE_THROWS_AS(trace_buffer::read(corrupted), std::runtime_error);
+  }
+
+  THEN("the ring buffer keeps the last records") {
+    trace_buffer small{5};
+    for (auto& r : records)
+      small.append(r);
+    REQUIRE(small.dropped() == 29);
+    auto last = small.records();
+    REQUIRE(last.size() == 5);
+    REQUIRE(last.front().head == records[29].head);
+
+    // the stacks started before the window are unknown: the push starts a
+    // new stack, the pops and free_stack are skipped
+    stack_pool<int, std::uint32_t> other;
+    auto skipped =
+        stack_utils::replay(last, other, [](std::uint32_t) { return 0; });
+    REQUIRE(skipped == 3);
+  }
+
+  THEN("heads and operations of a corrupted trace are checked") {
+    std::vector<trace_record> bad{
+        {0, std::uint64_t(1) << 60, 4, trace_record::push},
+        {std::uint64_t(1) << 60, 0, 0, trace_record::pop}};
+    stack_pool<int, std::uint32_t> other;
+    auto make = [](std::uint32_t) { return 0; };
+    REQUIRE(stack_utils::replay(bad, other, make) == 0);
+    REQUIRE(other.count_live() == 0);
+
+    bad.push_back({0, 0, 0, 7});
+    REQUIRE_THROWS_AS(stack_utils::replay(bad, other, make),
+                      std::runtime_error);
+  }
+}
@@ -0,0 +1,75 @@
+#include "catch.hpp"
+
+#include "stack_view.hpp"
+#include <algorithm>  // max_element, count_if, sort
+#include <cstdint>
+#include <iterator>
+#include <numeric>  // accumulate
+#include <stdexcept>
+#include <vector>
+
+SCENARIO("using stack views") {
+  stack_pool<int, std::uint16_t> pool{};
+  auto l = pool.new_stack();
+  for (int x : {3, 1, 4, 1, 5, 9, 2, 6})
+    l = pool.push(x, l);
+
+  auto view = make_stack_view(pool, l);
+  const auto& cpool = pool;
+  auto cview = make_stack_view(cpool, l);
+
+  THEN("it works with the algorithms in <algorithm>") {
+    REQUIRE(*std::max_element(cview.begin(), cview.end()) == 9);
+    REQUIRE(std::count_if(view.begin(), view.end(),
+                          [](int x) { return x == 1; }) == 2);
+    REQUIRE(std::accumulate(cview.begin(), cview.end(), 0) == 31);
+    REQUIRE(std::distance(view.begin(), view.end()) == 8);
+  }
+
+  THEN("values can be modified through a mutable view") {
+    for (auto& x : view)
+      x *= 2;
+    REQUIRE(pool.value(l) == 12);
+  }
+
+  THEN("iterators are regular") {
+    decltype(view)::iterator it;
+    REQUIRE(it == view.end());
+    const auto first = view.begin();
+    auto copy = first;
+    REQUIRE(copy == first);
+    auto moved = std::move(copy);
+    REQUIRE(*moved == 6);
+    REQUIRE(view.begin() != stack_sentinel{});
+    REQUIRE(view.end() == stack_sentinel{});
+  }
+
+  THEN("materialize copies the values in contiguous storage") {
+    auto v = cview.materialize();
+    REQUIRE(v == std::vector<int>{6, 2, 9, 5, 1, 4, 1, 3});
+    std::sort(v.begin(), v.end());
+    REQUIRE(v.front() == 1);
+    REQUIRE(make_stack_view(pool, pool.new_stack()).materialize().empty());
+    REQUIRE(decltype(view){}.materialize().empty());
+  }
+
+  THEN("invalid heads are rejected") {
+    REQUIRE_THROWS_AS(make_stack_view(pool, std::uint16_t(100)),
+                      std::out_of_range);
+  }
+
+#if __cplusplus >= 202002L
+  THEN("it is a view usable with C++20 ranges") {
+    static_assert(std::ranges::forward_range<decltype(view)>);
+    static_assert(std::ranges::view<decltype(cview)>);
+    static_assert(std::sentinel_for<stack_sentinel, decltype(view)::iterator>);
+    REQUIRE(*std::ranges::max_element(cview) == 9);
+
+    auto odd = cview | std::views::filter([](int x) { return x % 2 == 1; });
+    REQUIRE(std::ranges::distance(odd) == 5);
+
+    auto sub = std::ranges::subrange(view.begin(), stack_sentinel{});
+    REQUIRE(std::ranges::find(sub, 5) != sub.end());
+  }
+#endif
+}
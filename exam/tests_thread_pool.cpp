@@ -0,0 +1,90 @@
+#include "catch.hpp"
+
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+SCENARIO("using a task_deque") {
+  task_deque d{2};
+  std::vector<int> order;
+  for (int i = 0; i < 4; ++i)
+    d.push_bottom([&order, i]() { order.push_back(i); });
+
+  task_deque::task_type t;
+  THEN("the owner takes the newest task, thieves the oldest one") {
+    REQUIRE(d.pop_bottom(t));
+    t();
+    REQUIRE(d.steal_top(t));
+    t();
+    REQUIRE(d.steal_top(t));
+    t();
+    REQUIRE(d.pop_bottom(t));
+    t();
+    REQUIRE(!d.pop_bottom(t));
+    REQUIRE(!d.steal_top(t));
+    REQUIRE(order == std::vector<int>{3, 0, 1, 2});
+
+    AND_THEN("nodes are recycled") {
+      d.push_bottom([&order]() { order.push_back(4); });
+      REQUIRE(d.steal_top(t));
+      t();
+      REQUIRE(order.back() == 4);
+    }
+  }
+}
+
+SCENARIO("using a work_stealing_pool") {
+  work_stealing_pool tp{3};
+
+  THEN("submit returns the result of the task") {
+    auto f = tp.submit([]() { return 42; });
+    REQUIRE(f.get() == 42);
+  }
+
+  GIVEN("a pool of stacks with different sizes") {
+    stack_pool<int, std::uint32_t> pool;
+    std::vector<std::uint32_t> heads;
+    for (int s = 0; s < 50; ++s) {
+      auto h = pool.new_stack();
+      for (int i = 0; i < s * s; ++i)
+        h = pool.push(i, h);
+      heads.push_back(h);
+    }
+
+    THEN("parallel_for_each_stack visits each stack once") {
+      std::vector<std::size_t> sizes(heads.size(), 0);
+      const auto& cpool = pool;
+      tp.parallel_for_each_stack(
+          cpool, heads, [&heads, &sizes](const auto& p, std::uint32_t h) {
+            auto i = std::find(heads.begin(), heads.end(), h) - heads.begin();
+            sizes[i] += stack_utils::stack_size(p, h);
+          });
+      for (std::size_t s = 0; s < heads.size(); ++s)
+        REQUIRE(sizes[s] == s * s);
+    }
+
+    THEN("exceptions are propagated to the caller") {
+      REQUIRE_THROWS_AS(tp.parallel_for_each_stack(
+                            pool, heads,
+                            [](auto&, std::uint32_t h) {
+                              if (h == 0)
+                                throw std::runtime_error("empty stack");
+                            },
+                            1),
+                        std::runtime_error);
+    }
+
+    THEN("batches may be nested") {
+      std::atomic<std::size_t> n{0};
+      tp.parallel_for_each_stack(
+          pool, heads, [&tp, &heads, &n](auto& p, std::uint32_t) {
+            tp.parallel_for_each_stack(
+                p, heads, [&n](auto&, std::uint32_t) { ++n; }, 8);
+          });
+      REQUIRE(n == heads.size() * heads.size());
+    }
+  }
+}
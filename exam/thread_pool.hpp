@@ -0,0 +1,356 @@
+#pragma once
+
+#include "stack_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief A double-ended queue of tasks owned by a worker of a
+ * work_stealing_pool.
+ *
+ * Tasks are stored in a stack_pool: the deque is a stack going from the
+ * newest task (the bottom, used by the owner) to the oldest one (the top,
+ * where other workers steal from). Each task also keeps the address of the
+ * next newer task, so that the oldest one can be unlinked in O(1). Nodes of
+ * finished tasks are recycled by the stack_pool.
+ *
+ * All the operations hold a mutex, which is only contended when somebody is
+ * stealing.
+ */
+class task_deque {
+ public:
+  using task_type = std::function<void()>;
+
+ private:
+  using stack_type = std::uint32_t;
+
+  struct task_node {
+    task_type task;
+    stack_type newer;
+  };
+
+  stack_pool<task_node, stack_type> pool;
+  stack_type newest;
+  stack_type oldest;
+  std::mutex m;
+
+  task_type take(stack_type x) noexcept {
+    task_type t = std::move(pool.value(x).task);
+    // release the resources captured by the task right away
+    pool.value(x).task = nullptr;
+    return t;
+  }
+
+ public:
+  explicit task_deque(std::size_t n = 64)
+      : pool{n}, newest{pool.end()}, oldest{pool.end()} {}
+
+  /**
+   * @brief Add a task at the bottom of the deque.
+   *
+   * @param t
+   */
+  void push_bottom(task_type&& t) {
+    std::lock_guard<std::mutex> lock{m};
+    stack_type former = newest;
+    newest = pool.push(task_node{std::move(t), pool.end()}, newest);
+    if (pool.empty(former))
+      oldest = newest;
+    else
+      pool.value(former).newer = newest;
+  }
+
+  /**
+   * @brief Take the newest task (LIFO order, used by the owner).
+   *
+   * @param t Where the task is moved.
+   * @return true If a task was taken.
+   * @return false If the deque was empty.
+   */
+  bool pop_bottom(task_type& t) {
+    std::lock_guard<std::mutex> lock{m};
+    if (pool.empty(newest))
+      return false;
+
+    t = take(newest);
+    newest = pool.pop(newest);
+    if (pool.empty(newest))
+      oldest = pool.end();
+    else
+      pool.value(newest).newer = pool.end();
+    return true;
+  }
+
+  /**
+   * @brief Take the oldest task (FIFO order, used by thieves).
+   *
+   * @param t Where the task is moved.
+   * @return true If a task was taken.
+   * @return false If the deque was empty.
+   */
+  bool steal_top(task_type& t) {
+    std::lock_guard<std::mutex> lock{m};
+    if (pool.empty(oldest))
+      return false;
+
+    t = take(oldest);
+    stack_type newer = pool.value(oldest).newer;
+    if (pool.empty(newer))
+      newest = pool.end();
+    else
+      pool.next(newer) = pool.end();
+    // the oldest node is the last one of its stack, so this just frees it
+    pool.pop(oldest);
+    oldest = newer;
+    return true;
+  }
+};
+
+/**
+ * @brief A pool of threads which balance their load by stealing work from
+ * each other.
+ *
+ * Each worker owns a task_deque. A task submitted by a worker is pushed at
+ * the bottom of its own deque, other tasks are spread round-robin. A worker
+ * executes the newest task of its own deque first, and steals the oldest
+ * task of some other deque when its own deque is empty.
+ *
+ * Threads waiting for a batch of tasks (see work_stealing_pool::parallel_for)
+ * execute pending tasks meanwhile, therefore batches may be nested.
+ */
+class work_stealing_pool {
+  std::vector<std::unique_ptr<task_deque>> deques;
+  std::vector<std::thread> workers;
+
+  // number of tasks waiting in some deque
+  std::atomic<std::size_t> pending;
+  std::atomic<std::size_t> next_deque;
+  bool stop;
+  std::mutex sleep_mutex;
+  std::condition_variable wake_up;
+
+  // the worker index of the current thread, if it belongs to this pool
+  struct worker_id {
+    const work_stealing_pool* owner;
+    std::size_t index;
+  };
+  static worker_id& this_worker() noexcept {
+    static thread_local worker_id id{nullptr, 0};
+    return id;
+  }
+
+  void enqueue(task_deque::task_type&& t) {
+    std::size_t i = this_worker().owner == this
+                        ? this_worker().index
+                        : next_deque++ % deques.size();
+    // counted before it is published, otherwise a thief could take the task
+    // and decrement the counter first, which would wrap around
+    ++pending;
+    try {
+      deques[i]->push_bottom(std::move(t));
+    } catch (...) {
+      --pending;
+      throw;
+    }
+    // avoid lost wake-ups of workers which are about to wait
+    { std::lock_guard<std::mutex> lock{sleep_mutex}; }
+    wake_up.notify_one();
+  }
+
+  // take a task from the deque of the worker `first` (if any) or steal it
+  // from the others
+  bool take(std::size_t first, task_deque::task_type& t) {
+    if (first < deques.size() && deques[first]->pop_bottom(t)) {
+      --pending;
+      return true;
+    }
+    for (std::size_t k = 1; k <= deques.size(); ++k) {
+      if (deques[(first + k) % deques.size()]->steal_top(t)) {
+        --pending;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void work(std::size_t index) {
+    this_worker() = worker_id{this, index};
+    task_deque::task_type t;
+    while (true) {
+      if (take(index, t)) {
+        t();
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock{sleep_mutex};
+      wake_up.wait(lock, [this]() { return stop || pending.load() > 0; });
+      if (stop && pending.load() == 0)
+        return;
+    }
+  }
+
+ public:
+  /**
+   * @brief Construct a new pool and start its threads.
+   *
+   * @param n_threads Number of worker threads (at least one).
+   */
+  explicit work_stealing_pool(
+      std::size_t n_threads = std::thread::hardware_concurrency())
+      : pending{0}, next_deque{0}, stop{false} {
+    n_threads = std::max<std::size_t>(n_threads, 1);
+    for (std::size_t i = 0; i < n_threads; ++i)
+      deques.emplace_back(new task_deque{});
+    for (std::size_t i = 0; i < n_threads; ++i)
+      workers.emplace_back(&work_stealing_pool::work, this, i);
+  }
+
+  work_stealing_pool(const work_stealing_pool&) = delete;
+  work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+  /**
+   * @brief Wait for all the submitted tasks to be executed, then join the
+   * threads.
+   */
+  ~work_stealing_pool() noexcept {
+    {
+      std::lock_guard<std::mutex> lock{sleep_mutex};
+      stop = true;
+    }
+    wake_up.notify_all();
+    for (auto& w : workers)
+      w.join();
+  }
+
+  std::size_t size() const noexcept { return workers.size(); }
+
+  /**
+   * @brief Execute a pending task, if there is one, in the calling thread.
+   *
+   * @return true If a task was executed.
+   * @return false Otherwise.
+   */
+  bool run_pending_task() {
+    task_deque::task_type t;
+    std::size_t first =
+        this_worker().owner == this ? this_worker().index : deques.size();
+    if (!take(first, t))
+      return false;
+    t();
+    return true;
+  }
+
+  /**
+   * @brief Submit a task to the pool. The returned future holds the result
+   * (or the exception) of `f()`.
+   *
+   * @tparam F A callable object taking no arguments.
+   * @param f
+   * @return std::future<decltype(f())>
+   */
+  template <typename F>
+  auto submit(F&& f) -> std::future<decltype(f())> {
+    using result_type = decltype(f());
+    // std::function needs a copyable callable
+    auto task = std::make_shared<std::packaged_task<result_type()>>(
+        std::forward<F>(f));
+    auto result = task->get_future();
+    enqueue([task]() { (*task)(); });
+    return result;
+  }
+
+  /**
+   * @brief Call `f(i)` for each `i` in `[0, n)`, in parallel, and wait for all
+   * the calls to be completed. The calling thread executes pending tasks while
+   * waiting.
+   *
+   * Indices are grouped in tasks of `grain` consecutive indices. If an
+   * exception is thrown by some call, the first one is rethrown after all the
+   * tasks are completed. If a task cannot be submitted, the tasks submitted
+   * before it are completed, then the exception is rethrown.
+   *
+   * @tparam F A callable object taking an index.
+   * @param n
+   * @param f
+   * @param grain Number of indices per task, 0 means that it is chosen by the
+   *            pool.
+   */
+  template <typename F>
+  void parallel_for(std::size_t n, F f, std::size_t grain = 0) {
+    if (grain == 0)
+      grain = std::max<std::size_t>(n / (8 * size()), 1);
+
+    const std::size_t tasks = (n + grain - 1) / grain;
+    std::atomic<std::size_t> remaining{tasks};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto wait = [this, &remaining]() {
+      while (remaining.load() != 0)
+        if (!run_pending_task())
+          std::this_thread::yield();
+    };
+
+    std::size_t submitted = 0;
+    try {
+      for (std::size_t first = 0; first < n; first += grain) {
+        std::size_t last = std::min(first + grain, n);
+        enqueue([&, first, last]() {
+          try {
+            for (std::size_t i = first; i < last; ++i)
+              f(i);
+          } catch (...) {
+            std::lock_guard<std::mutex> lock{error_mutex};
+            if (!error)
+              error = std::current_exception();
+          }
+          --remaining;
+        });
+        ++submitted;
+      }
+    } catch (...) {
+      // the submitted tasks refer to the locals of this call
+      remaining -= tasks - submitted;
+      wait();
+      throw;
+    }
+    wait();
+
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  /**
+   * @brief Call `f(pool, head)` for each head in `heads`, in parallel, and
+   * wait for all the calls to be completed (see
+   * work_stealing_pool::parallel_for).
+   *
+   * @tparam P Type of the stack pool (possibly const).
+   * @tparam H Type of the heads.
+   * @tparam F A callable object taking a pool and a head.
+   * @param pool Stack pool containing the stacks.
+   * @param heads Heads of the stacks to be processed.
+   * @param f
+   * @param grain Number of heads per task, 0 means that it is chosen by the
+   *            pool.
+   */
+  template <typename P, typename H, typename F>
+  void parallel_for_each_stack(P& pool,
+                               const std::vector<H>& heads,
+                               F f,
+                               std::size_t grain = 0) {
+    parallel_for(
+        heads.size(), [&pool, &heads, &f](std::size_t i) { f(pool, heads[i]); },
+        grain);
+  }
+};